@@ -0,0 +1,331 @@
+// Headless benchmark, runs every pattern on every engine and prints one JSON
+// object per run. No window is opened and SDL's video subsystem is never
+// initialized. Soups are seeded from --seed so runs are reproducible, and
+// peak_rss_kb is the high water mark of the whole process so far. Filling
+// the board with soup is timed on its own as the "soup-fill" bench.
+// --pattern times loading an .rle / .mc file into the board first.
+// --topology joins the edges of the board for the rows and tiles engines,
+// the others run the unbounded plane and are skipped. So are they for
+// Larger than Life rules, which only run on the bounded plane.
+// --lenia also times Lenia with those parameters on a soup as "lenia/fft",
+// the sides rounded up to powers of two like the window does.
+//
+//   golc-bench [--width N] [--height N] [--generations N] [--threads N]
+//              [--seed N] [--rule RULE] [--topology NAME] [--pattern FILE]
+//              [--lenia PARAMS] [--only SUBSTRING]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "SDL2/SDL.h"
+#include "hashlife.h"
+#include "lenia.h"
+#include "life.h"
+#include "pattern.h"
+#include "pool.h"
+#include "soup.h"
+#include "universe.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#define WIDTH 2048
+#define HEIGHT 2048
+#define GENERATIONS 1000
+#define SEED 1
+
+typedef struct Pattern {
+    const char *name;
+    const char *rows[10]; // 'O' is alive, NULL terminated
+    int density;          // percent, random soup when there are no rows
+} pattern_t;
+
+static const pattern_t patterns[] = {
+    {"r-pentomino", {".OO", "OO.", ".O.", NULL}, 0},
+    {"acorn", {".O.....", "...O...", "OO..OOO", NULL}, 0},
+    {"gosper-gun", {
+        "........................O...........",
+        "......................O.O...........",
+        "............OO......OO............OO",
+        "...........O...O....OO............OO",
+        "OO........O.....O...OO..............",
+        "OO........O...O.OO....O.O...........",
+        "..........O.....O.......O...........",
+        "...........O...O....................",
+        "............OO......................",
+        NULL}, 0},
+    {"soup-10", {NULL}, 10},
+    {"soup-35", {NULL}, 35},
+    {"soup-50", {NULL}, 50},
+};
+
+typedef struct Bench {
+    grid_t grid, next;
+    tiles_t tiles;
+    pool_t *pool;
+    hashlife_t *hashlife;
+    universe_t *universe;
+} bench_t;
+
+static bench_t bench;
+
+static void seed_grid(const pattern_t *p, uint64_t seed) {
+    grid_clear(&bench.grid);
+    grid_clear(&bench.next);
+    tiles_mark_all(&bench.tiles);
+
+    if (!p->rows[0]) {
+        soup_fill(&bench.grid, bench.pool, soup_next(&seed), p->density, 0, bench.grid.height, 0, bench.grid.width);
+        return;
+    }
+
+    int h = 0, w = 0;
+    for (; p->rows[h]; h++) {
+        w = SDL_max(w, (int) SDL_strlen(p->rows[h]));
+    }
+    const int y0 = (bench.grid.height - h) / 2, x0 = (bench.grid.width - w) / 2;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; p->rows[y][x]; x++) {
+            if (p->rows[y][x] == 'O') grid_set(&bench.grid, y0 + y, x0 + x, 1);
+        }
+    }
+}
+
+static void step_rows(void *data, const int y0, const int y1) {
+    (void) data;
+    life_step_rows(&bench.grid, &bench.next, y0, y1);
+}
+
+static void step_tiles(void *data, const int ty0, const int ty1) {
+    (void) data;
+    life_step_tiles(&bench.grid, &bench.next, &bench.tiles, ty0, ty1);
+}
+
+static void swap_grids(void) {
+    const grid_t tmp = bench.grid;
+    bench.grid = bench.next;
+    bench.next = tmp;
+}
+
+static uint64_t grid_population(const grid_t *g) {
+    uint64_t n = 0;
+    for (int y = 0; y < g->height; y++) {
+        const uint64_t *row = grid_row(g, y);
+        for (int i = 0; i < g->words; i++) {
+            n += (uint64_t) life_popcount(row[i]);
+        }
+    }
+    return n;
+}
+
+static long peak_rss_kb(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Runs `generations` steps of one engine, returns the final population
+static uint64_t run(const char *engine, const int generations) {
+    if (SDL_strcmp(engine, "rows") == 0) {
+        for (int g = 0; g < generations; g++) {
+            grid_wrap(&bench.grid);
+            pool_run(bench.pool, step_rows, NULL, bench.grid.height);
+            grid_unwrap(&bench.grid);
+            swap_grids();
+        }
+        return grid_population(&bench.grid);
+    }
+    if (SDL_strcmp(engine, "tiles") == 0) {
+        for (int g = 0; g < generations; g++) {
+            grid_wrap(&bench.grid);
+            pool_run(bench.pool, step_tiles, NULL, bench.tiles.rows);
+            grid_unwrap(&bench.grid);
+            swap_grids();
+            tiles_swap(&bench.tiles);
+        }
+        return grid_population(&bench.grid);
+    }
+    if (SDL_strcmp(engine, "universe") == 0) {
+        universe_clear(bench.universe);
+        universe_load_grid(bench.universe, &bench.grid, NULL);
+        for (int g = 0; g < generations; g++) {
+            universe_step(bench.universe);
+        }
+        return universe_population(bench.universe);
+    }
+    // HashLife on the unbounded plane, one step per set bit of the count
+    bool loaded = hashlife_load_grid(bench.hashlife, &bench.grid, 0, 0);
+    for (int k = 0; loaded && k < 31; k++) {
+        if (generations >> k & 1) loaded = hashlife_step(bench.hashlife, k);
+    }
+    if (!loaded) fprintf(stderr, "golc-bench: HashLife ran out of memory\n");
+    return hashlife_population(bench.hashlife);
+}
+
+static void bench_load(const char *path) {
+    SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+    const Sint64 bytes = rw ? SDL_RWsize(rw) : -1;
+    if (rw) SDL_RWclose(rw);
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    if (!pattern_load(path, &bench.grid)) {
+        fprintf(stderr, "golc-bench: couldn't load %s: %s\n", path, SDL_GetError());
+        return;
+    }
+    const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+
+    printf("{\"bench\":\"load\",\"file\":\"%s\",\"bytes\":%lld,\"seconds\":%.6f,\"mb_per_sec\":%.1f,"
+           "\"population\":%llu,\"peak_rss_kb\":%ld}\n",
+           path, (long long) bytes, seconds, (double) bytes / seconds / 1e6,
+           (unsigned long long) grid_population(&bench.grid), peak_rss_kb());
+    fflush(stdout);
+}
+
+static void bench_soup(const uint64_t seed) {
+    // Once to fault the board's pages in, they'd swamp the rest
+    soup_fill(&bench.grid, bench.pool, seed, 35, 0, bench.grid.height, 0, bench.grid.width);
+    const Uint64 start = SDL_GetPerformanceCounter();
+    soup_fill(&bench.grid, bench.pool, seed, 35, 0, bench.grid.height, 0, bench.grid.width);
+    const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+    const double bytes = (double) bench.grid.words * sizeof(uint64_t) * bench.grid.height * bench.grid.planes;
+
+    printf("{\"bench\":\"soup-fill\",\"width\":%d,\"height\":%d,\"threads\":%d,\"seconds\":%.6f,\"gb_per_sec\":%.2f,"
+           "\"population\":%llu,\"peak_rss_kb\":%ld}\n",
+           bench.grid.width, bench.grid.height, pool_threads(bench.pool), seconds, bytes / seconds / 1e9,
+           (unsigned long long) grid_population(&bench.grid), peak_rss_kb());
+    fflush(stdout);
+}
+
+static bool bench_lenia(const char *params_arg, const int width, const int height, const int generations, const uint64_t seed) {
+    lenia_params_t params;
+    if (!lenia_parse(&params, params_arg)) {
+        fprintf(stderr, "golc-bench: unknown Lenia parameters %s\n", params_arg);
+        return false;
+    }
+    lenia_t *l = lenia_create(&params, lenia_side(width), lenia_side(height), bench.pool);
+    if (!l) {
+        fprintf(stderr, "golc-bench: couldn't set up Lenia: %s\n", SDL_GetError());
+        return false;
+    }
+    lenia_soup(l, seed, 50, 0, l->height, 0, l->width);
+    const Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < generations; i++) lenia_step(l);
+    const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+
+    char name[64];
+    lenia_format(&params, name, sizeof(name));
+    printf("{\"bench\":\"lenia/fft\",\"rule\":\"%s\",\"rule_kernel\":\"lenia\",\"kernel\":\"%s\",\"threads\":%d,"
+           "\"width\":%d,\"height\":%d,\"generations\":%d,\"seconds\":%.6f,"
+           "\"gens_per_sec\":%.1f,\"cells_per_sec\":%.4g,\"population\":%llu,\"peak_rss_kb\":%ld}\n",
+           name, fft_kernel_name(l->fft), pool_threads(bench.pool),
+           l->width, l->height, generations, seconds,
+           generations / seconds, (double) l->width * l->height * generations / seconds,
+           (unsigned long long) l->stats.population, peak_rss_kb());
+    fflush(stdout);
+    lenia_destroy(l);
+    return true;
+}
+
+static int arg_value(const int argc, char *argv[], const char *flag, const int fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (SDL_strcmp(argv[i], flag) == 0) return SDL_atoi(argv[i + 1]);
+    }
+    return fallback;
+}
+
+static const char *arg_string(const int argc, char *argv[], const char *flag) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (SDL_strcmp(argv[i], flag) == 0) return argv[i + 1];
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    static const char *const engines[] = {"rows", "tiles", "universe", "hashlife"};
+    const int width = arg_value(argc, argv, "--width", WIDTH);
+    const int height = arg_value(argc, argv, "--height", HEIGHT);
+    const int generations = arg_value(argc, argv, "--generations", GENERATIONS);
+    const uint64_t seed = (uint64_t) arg_value(argc, argv, "--seed", SEED);
+    const char *only = arg_string(argc, argv, "--only");
+    const char *rule_arg = arg_string(argc, argv, "--rule");
+    const char *pattern = arg_string(argc, argv, "--pattern");
+    const char *topology_arg = arg_string(argc, argv, "--topology");
+    const char *lenia = arg_string(argc, argv, "--lenia");
+
+    rule_t rule = RULE_CONWAY;
+    if (rule_arg && !rule_parse(&rule, rule_arg)) {
+        fprintf(stderr, "golc-bench: unknown rule %s\n", rule_arg);
+        return 1;
+    }
+    topology_t topology = TOPOLOGY_PLANE;
+    if (topology_arg && !topology_parse(&topology, topology_arg)) {
+        fprintf(stderr, "golc-bench: unknown topology %s\n", topology_arg);
+        return 1;
+    }
+    if (rule.radius && topology != TOPOLOGY_PLANE) {
+        fprintf(stderr, "golc-bench: Larger than Life rules only run on the plane\n");
+        return 1;
+    }
+    char rule_name[64];
+    rule_format(&rule, rule_name, sizeof(rule_name));
+
+    life_init();
+    life_set_rule(&rule);
+    life_set_topology(topology);
+    bench.pool = pool_create(arg_value(argc, argv, "--threads", 0));
+    bench.hashlife = hashlife_create(0);
+    bench.universe = universe_create(rule_planes(&rule));
+    if (!bench.pool || !bench.hashlife || !bench.universe
+            || !grid_create_planes(&bench.grid, width, height, rule_planes(&rule))
+            || !grid_create_planes(&bench.next, width, height, rule_planes(&rule))
+            || !tiles_create(&bench.tiles, &bench.grid)) {
+        fprintf(stderr, "golc-bench: couldn't set up a %d x %d board\n", width, height);
+        return 1;
+    }
+    const bool hashlife = hashlife_set_rule(bench.hashlife, &rule);
+    if (pattern) bench_load(pattern);
+    if (!only || SDL_strstr("soup-fill", only)) bench_soup(seed);
+    if (lenia && (!only || SDL_strstr("lenia/fft", only)) && !bench_lenia(lenia, width, height, generations, seed)) return 1;
+
+    for (size_t p = 0; p < SDL_arraysize(patterns); p++) {
+        for (size_t e = 0; e < SDL_arraysize(engines); e++) {
+            char name[64];
+            SDL_snprintf(name, sizeof(name), "%s/%s", patterns[p].name, engines[e]);
+            if (only && !SDL_strstr(name, only)) continue;
+            if (!hashlife && SDL_strcmp(engines[e], "hashlife") == 0) continue;
+            const bool bounded = SDL_strcmp(engines[e], "rows") == 0 || SDL_strcmp(engines[e], "tiles") == 0;
+            if ((topology != TOPOLOGY_PLANE || rule.radius) && !bounded) continue;
+
+            seed_grid(&patterns[p], seed);
+            const Uint64 start = SDL_GetPerformanceCounter();
+            const uint64_t population = run(engines[e], generations);
+            const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+
+            printf("{\"bench\":\"%s\",\"pattern\":\"%s\",\"engine\":\"%s\",\"rule\":\"%s\",\"topology\":\"%s\",\"rule_kernel\":\"%s\","
+                   "\"kernel\":\"%s\",\"threads\":%d,"
+                   "\"width\":%d,\"height\":%d,\"generations\":%d,\"seconds\":%.6f,"
+                   "\"gens_per_sec\":%.1f,\"cells_per_sec\":%.4g,\"population\":%llu,\"peak_rss_kb\":%ld}\n",
+                   name, patterns[p].name, engines[e], rule_name, topology_name(topology), life_rule_kernel_name(), life_kernel_name(), pool_threads(bench.pool),
+                   width, height, generations, seconds,
+                   generations / seconds, (double) width * height * generations / seconds,
+                   (unsigned long long) population, peak_rss_kb());
+            fflush(stdout);
+        }
+    }
+
+    grid_destroy(&bench.grid);
+    grid_destroy(&bench.next);
+    tiles_destroy(&bench.tiles);
+    hashlife_destroy(bench.hashlife);
+    universe_destroy(bench.universe);
+    pool_destroy(bench.pool);
+    return 0;
+}
@@ -0,0 +1,540 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "census.h"
+#include "cycle.h"
+#include "life.h"
+#include "soup.h"
+
+#define BOARD 512           // a side of a lane's board, a multiple of 64
+#define WORDS (BOARD / 64)
+#define SOUP 16             // a side of a soup, in the middle of the board
+#define SOUP_DENSITY 50     // percent
+// Objects leaving the square of this side in the middle of the board are
+// taken out once they keep going on their own, ships flying off mostly
+#define KEEP 192
+#define EDGE 4              // anything else this close and the soup outgrew its board
+#define ESCAPE_EVERY 8      // generations between looks at the margin
+#define ESCAPE_WAIT 8       // looks skipped after something there wouldn't settle
+#define MAX_PERIOD 256      // the longest a settled board may take to repeat
+#define SHIP_PERIOD 64      // the longest a ship may take to come back
+#define TABLE_MIN 64
+#define CODE_SIZE ((BOARD + 2) * (BOARD / 5 + 2))
+
+typedef struct Entry {
+    char *code;
+    uint64_t count;
+} entry_t;
+
+// Counts by code, open addressed and at most half full
+typedef struct Table {
+    entry_t *entries;
+    size_t capacity, count;
+} table_t;
+
+struct Census {
+    table_t table;
+    uint64_t soups, unsettled;
+};
+
+// A pattern cut down to its bounding box, a byte per cell
+typedef struct Shape {
+    int width, height;
+    uint8_t *cells;
+} shape_t;
+
+typedef struct Lane {
+    grid_t grid, next;
+    tiles_t tiles;
+    cycle_t *cycle;
+    grid_t scratch[2];  // objects run on their own in here
+    uint64_t *phases;   // every cell alive in any phase of a settled board
+    uint64_t *marks;    // cells not flooded yet, laid out like phases
+    int *cells, *stack; // of an object, as y * BOARD + x
+    shape_t first, shape, turned;
+    char *code, *best, *name;
+    table_t table;
+    uint64_t soups, unsettled;
+    bool failed;        // out of memory
+    int wait;           // margin looks to skip, debris out there is still busy
+    // The bits of each word of a row outside the KEEP square, for rows
+    // above or below it and rows across it
+    uint64_t outside[2][WORDS];
+} lane_t;
+
+typedef struct Search {
+    census_t *census;
+    uint64_t seed, first;
+    int count;
+    SDL_atomic_t next;  // soup to hand out
+    SDL_atomic_t failed;
+    SDL_mutex *lock;    // on census
+} search_t;
+
+// FNV-1a
+static size_t code_hash(const char *code) {
+    uint64_t h = UINT64_C(0xCBF29CE484222325);
+    for (; *code; code++) h = (h ^ (uint8_t) *code) * UINT64_C(0x100000001B3);
+    return (size_t) h;
+}
+
+static entry_t *table_slot(entry_t *entries, const size_t capacity, const char *code) {
+    size_t i = code_hash(code) & (capacity - 1);
+    while (entries[i].code && SDL_strcmp(entries[i].code, code) != 0) i = (i + 1) & (capacity - 1);
+    return &entries[i];
+}
+
+static bool table_grow(table_t *t) {
+    const size_t capacity = t->capacity ? 2 * t->capacity : TABLE_MIN;
+    entry_t *entries = SDL_calloc(capacity, sizeof(*entries));
+    if (!entries) return false;
+    for (size_t i = 0; i < t->capacity; i++) {
+        if (t->entries[i].code) *table_slot(entries, capacity, t->entries[i].code) = t->entries[i];
+    }
+    SDL_free(t->entries);
+    t->entries = entries;
+    t->capacity = capacity;
+    return true;
+}
+
+static bool table_add(table_t *t, const char *code, const uint64_t count) {
+    if (2 * (t->count + 1) > t->capacity && !table_grow(t)) return false;
+    entry_t *e = table_slot(t->entries, t->capacity, code);
+    if (!e->code) {
+        if (!(e->code = SDL_strdup(code))) return false;
+        t->count++;
+    }
+    e->count += count;
+    return true;
+}
+
+static void table_free(table_t *t) {
+    for (size_t i = 0; i < t->capacity; i++) SDL_free(t->entries[i].code);
+    SDL_free(t->entries);
+    memset(t, 0, sizeof(*t));
+}
+
+static void lane_destroy(lane_t *l) {
+    grid_destroy(&l->grid);
+    grid_destroy(&l->next);
+    tiles_destroy(&l->tiles);
+    cycle_destroy(l->cycle);
+    grid_destroy(&l->scratch[0]);
+    grid_destroy(&l->scratch[1]);
+    SDL_free(l->phases);
+    SDL_free(l->marks);
+    SDL_free(l->cells);
+    SDL_free(l->stack);
+    SDL_free(l->first.cells);
+    SDL_free(l->shape.cells);
+    SDL_free(l->turned.cells);
+    SDL_free(l->code);
+    SDL_free(l->best);
+    SDL_free(l->name);
+    table_free(&l->table);
+    memset(l, 0, sizeof(*l));
+}
+
+static bool lane_create(lane_t *l) {
+    memset(l, 0, sizeof(*l));
+    const size_t cells = (size_t) BOARD * BOARD;
+    const bool grids = grid_create(&l->grid, BOARD, BOARD) && grid_create(&l->next, BOARD, BOARD)
+                       && grid_create(&l->scratch[0], BOARD, BOARD) && grid_create(&l->scratch[1], BOARD, BOARD)
+                       && tiles_create(&l->tiles, &l->grid);
+    l->cycle = cycle_create(MAX_PERIOD);
+    l->phases = SDL_malloc(cells / 8);
+    l->marks = SDL_malloc(cells / 8);
+    l->cells = SDL_malloc(cells * sizeof(int));
+    l->stack = SDL_malloc(cells * sizeof(int));
+    l->first.cells = SDL_malloc(cells);
+    l->shape.cells = SDL_malloc(cells);
+    l->turned.cells = SDL_malloc(cells);
+    l->code = SDL_malloc(CODE_SIZE);
+    l->best = SDL_malloc(CODE_SIZE);
+    l->name = SDL_malloc(CODE_SIZE + 32);
+    if (!grids || !l->cycle || !l->phases || !l->marks || !l->cells || !l->stack || !l->first.cells
+            || !l->shape.cells || !l->turned.cells || !l->code || !l->best || !l->name) {
+        lane_destroy(l);
+        return false;
+    }
+    const int lo = (BOARD - KEEP) / 2, hi = lo + KEEP;
+    for (int w = 0; w < WORDS; w++) {
+        l->outside[0][w] = ~UINT64_C(0);
+        l->outside[1][w] = ~UINT64_C(0);
+        for (int x = SDL_max(lo, w * 64); x < SDL_min(hi, w * 64 + 64); x++) l->outside[1][w] &= ~(UINT64_C(1) << (x % 64));
+    }
+    return true;
+}
+
+static void count(lane_t *l, const char *code) {
+    if (!table_add(&l->table, code, 1)) l->failed = true;
+}
+
+static void load_marks(lane_t *l, const uint64_t *rows, const ptrdiff_t stride) {
+    for (int y = 0; y < BOARD; y++) memcpy(l->marks + y * WORDS, rows + y * stride, WORDS * sizeof(uint64_t));
+}
+
+static bool take_mark(lane_t *l, const int y, const int x) {
+    uint64_t *w = &l->marks[y * WORDS + x / 64];
+    const uint64_t bit = UINT64_C(1) << (x % 64);
+    if (!(*w & bit)) return false;
+    *w &= ~bit;
+    return true;
+}
+
+// Collects the marked cells connected to `start` into l->cells, counting
+// cells up to `radius` apart in either direction as connected, and unmarks
+// them. Returns how many there were.
+static int flood(lane_t *l, const int start, const int radius) {
+    int n = 0, top = 0;
+    l->stack[top++] = start;
+    take_mark(l, start / BOARD, start % BOARD);
+    while (top) {
+        const int c = l->stack[--top], y = c / BOARD, x = c % BOARD;
+        l->cells[n++] = c;
+        for (int ny = SDL_max(y - radius, 0); ny <= SDL_min(y + radius, BOARD - 1); ny++) {
+            for (int nx = SDL_max(x - radius, 0); nx <= SDL_min(x + radius, BOARD - 1); nx++) {
+                if (take_mark(l, ny, nx)) l->stack[top++] = ny * BOARD + nx;
+            }
+        }
+    }
+    return n;
+}
+
+// Cuts the live cells of rows [y0, y1) and words [w0, w1) of g down to
+// their bounding box, whose corner goes in *x, *y. False if there are none.
+static bool cut(const grid_t *g, shape_t *s, const int y0, const int y1, const int w0, const int w1, int *x, int *y) {
+    int top = y1, bottom = y0 - 1, left = w1 * 64, right = w0 * 64 - 1;
+    for (int row = y0; row < y1; row++) {
+        const uint64_t *r = grid_row(g, row);
+        for (int w = w0; w < w1; w++) {
+            if (!r[w]) continue;
+            top = SDL_min(top, row);
+            bottom = row;
+            left = SDL_min(left, w * 64 + life_lowest_bit(r[w]));
+            right = SDL_max(right, w * 64 + life_highest_bit(r[w]));
+        }
+    }
+    if (bottom < top) return false;
+    s->width = right - left + 1;
+    s->height = bottom - top + 1;
+    for (int row = 0; row < s->height; row++) {
+        for (int col = 0; col < s->width; col++) s->cells[row * s->width + col] = (uint8_t) grid_get(g, top + row, left + col);
+    }
+    *x = left;
+    *y = top;
+    return true;
+}
+
+static bool same_shape(const shape_t *a, const shape_t *b) {
+    return a->width == b->width && a->height == b->height && memcmp(a->cells, b->cells, (size_t) a->width * a->height) == 0;
+}
+
+// One of the 8 ways to turn and mirror src: bit 0 flips it left to right,
+// bit 1 upside down, bit 2 swaps rows and columns
+static void orient(const shape_t *src, shape_t *dst, const int o) {
+    dst->width = o & 4 ? src->height : src->width;
+    dst->height = o & 4 ? src->width : src->height;
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            const int fx = o & 1 ? src->width - 1 - x : x, fy = o & 2 ? src->height - 1 - y : y;
+            dst->cells[o & 4 ? fx * dst->width + fy : fy * dst->width + fx] = src->cells[y * src->width + x];
+        }
+    }
+}
+
+// Extended Wechsler format: strips of 5 rows separated by z, a character
+// per column of a strip for its 5 cells (the top one is bit 0), runs of
+// blank columns shortened to w (2), x (3) or y and a count (4 to 39) and
+// the ones ending a strip left out
+static void wechsler(const shape_t *s, char *out) {
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    for (int strip = 0; strip * 5 < s->height; strip++) {
+        if (strip) *out++ = 'z';
+        int zeros = 0;
+        for (int x = 0; x < s->width; x++) {
+            int v = 0;
+            for (int k = 0; k < 5 && strip * 5 + k < s->height; k++) v |= s->cells[(strip * 5 + k) * s->width + x] << k;
+            if (!v) {
+                zeros++;
+                continue;
+            }
+            for (; zeros >= 40; zeros -= 39) *out++ = 'y', *out++ = 'z';
+            if (zeros == 1) *out++ = '0';
+            else if (zeros == 2) *out++ = 'w';
+            else if (zeros == 3) *out++ = 'x';
+            else if (zeros) *out++ = 'y', *out++ = digits[zeros - 4];
+            zeros = 0;
+            *out++ = digits[v];
+        }
+    }
+    *out = 0;
+}
+
+// Keeps the shortest, then alphabetically first code of every orientation
+// of s in l->best
+static void best_code(lane_t *l, const shape_t *s) {
+    for (int o = 0; o < 8; o++) {
+        orient(s, &l->turned, o);
+        wechsler(&l->turned, l->code);
+        const size_t n = SDL_strlen(l->code), best = SDL_strlen(l->best);
+        if (!*l->best || n < best || (n == best && SDL_strcmp(l->code, l->best) < 0)) SDL_memcpy(l->best, l->code, n + 1);
+    }
+}
+
+// Rows [y0, y1) and words [w0, w1) of a scratch grid
+typedef struct Window {
+    int y0, y1, w0, w1;
+} window_t;
+
+// Puts l->cells[0, n) into the first scratch grid, returns the window it
+// can't leave in `steps` generations, nothing moves faster than a cell a
+// generation
+static window_t place(lane_t *l, const int n, const int steps) {
+    int x0 = BOARD, y0 = BOARD, x1 = 0, y1 = 0;
+    for (int i = 0; i < n; i++) {
+        const int y = l->cells[i] / BOARD, x = l->cells[i] % BOARD;
+        grid_set(&l->scratch[0], y, x, 1);
+        x0 = SDL_min(x0, x);
+        y0 = SDL_min(y0, y);
+        x1 = SDL_max(x1, x);
+        y1 = SDL_max(y1, y);
+    }
+    return (window_t) {SDL_max(y0 - steps - 1, 0), SDL_min(y1 + steps + 2, BOARD),
+                       SDL_max(x0 - steps - 1, 0) / 64, SDL_min(x1 + steps + 1, BOARD - 1) / 64 + 1};
+}
+
+// Steps the scratch grids, the newest generation is always scratch[0]
+static void step(lane_t *l, const window_t *w) {
+    life_step_words(&l->scratch[0], &l->scratch[1], w->y0, w->y1, w->w0, w->w1);
+    const grid_t tmp = l->scratch[0];
+    l->scratch[0] = l->scratch[1];
+    l->scratch[1] = tmp;
+}
+
+static void clear(lane_t *l, const window_t *w) {
+    for (int y = w->y0; y < w->y1; y++) {
+        memset(grid_row(&l->scratch[0], y) + w->w0, 0, (size_t) (w->w1 - w->w0) * sizeof(uint64_t));
+        memset(grid_row(&l->scratch[1], y) + w->w0, 0, (size_t) (w->w1 - w->w0) * sizeof(uint64_t));
+    }
+}
+
+// Runs the object made of l->cells[0, n) on its own until it comes back,
+// for up to max_period generations, and writes its apgcode into l->name.
+// False if it doesn't come back.
+static bool name(lane_t *l, const int n, const int max_period) {
+    window_t w = place(l, n, max_period);
+    int fx, fy, x = 0, y = 0, period = 0;
+    cut(&l->scratch[0], &l->first, w.y0, w.y1, w.w0, w.w1, &fx, &fy);
+    for (int p = 1; p <= max_period; p++) {
+        step(l, &w);
+        if (!cut(&l->scratch[0], &l->shape, w.y0, w.y1, w.w0, w.w1, &x, &y)) break;
+        if (same_shape(&l->shape, &l->first)) {
+            period = p;
+            break;
+        }
+    }
+    clear(l, &w);
+    if (!period) return false;
+
+    // Once more for the codes of its phases, now that it's known to be
+    // worth it
+    w = place(l, n, period);
+    l->best[0] = 0;
+    for (int p = 0; p < period; p++) {
+        int px, py;
+        cut(&l->scratch[0], &l->shape, w.y0, w.y1, w.w0, w.w1, &px, &py);
+        best_code(l, &l->shape);
+        step(l, &w);
+    }
+    clear(l, &w);
+
+    if (x != fx || y != fy) SDL_snprintf(l->name, CODE_SIZE + 32, "xq%d_%s", period, l->best);
+    else if (period > 1) SDL_snprintf(l->name, CODE_SIZE + 32, "xp%d_%s", period, l->best);
+    else SDL_snprintf(l->name, CODE_SIZE + 32, "xs%d_%s", n, l->best);
+    return true;
+}
+
+// The bits of row y outside the KEEP square, a word each
+static inline const uint64_t *outside(const lane_t *l, const int y) {
+    const int lo = (BOARD - KEEP) / 2;
+    return l->outside[y >= lo && y < lo + KEEP];
+}
+
+// Whether any of l->cells[0, n) is still in the KEEP square
+static bool reaches_inside(const lane_t *l, const int n) {
+    for (int i = 0; i < n; i++) {
+        const int y = l->cells[i] / BOARD, x = l->cells[i] % BOARD;
+        if (!(outside(l, y)[x / 64] >> (x % 64) & 1)) return true;
+    }
+    return false;
+}
+
+// Takes out and counts whatever is all the way out of the KEEP square and
+// keeps going on its own. The rest is left alone until it comes within
+// EDGE of the edge, then the soup outgrew its board and this returns false.
+static bool escape(lane_t *l) {
+    grid_t *g = &l->grid;
+    bool loaded = false, removed = false;
+    for (int y = 0; y < BOARD; y++) {
+        const uint64_t *row = grid_row(g, y), *out = outside(l, y);
+        for (int w = 0; w < WORDS; w++) {
+            if (!(row[w] & out[w])) continue;
+            if (!loaded) load_marks(l, grid_row(g, 0), g->stride);
+            loaded = true;
+            for (uint64_t bits = row[w] & out[w] & l->marks[y * WORDS + w]; bits; bits &= l->marks[y * WORDS + w]) {
+                const int x = w * 64 + life_lowest_bit(bits);
+                // The cells of a ship aren't all next to each other
+                const int n = flood(l, y * BOARD + x, 2);
+                if (reaches_inside(l, n)) continue;
+                if (!name(l, n, SHIP_PERIOD)) {
+                    l->wait = ESCAPE_WAIT;
+                    for (int i = 0; i < n; i++) {
+                        const int cy = l->cells[i] / BOARD, cx = l->cells[i] % BOARD;
+                        if (SDL_min(SDL_min(cy, BOARD - 1 - cy), SDL_min(cx, BOARD - 1 - cx)) < EDGE) return false;
+                    }
+                    continue;
+                }
+                count(l, l->name);
+                for (int i = 0; i < n; i++) {
+                    grid_set(g, l->cells[i] / BOARD, l->cells[i] % BOARD, 0);
+                    tiles_mark(&l->tiles, l->cells[i] / BOARD, l->cells[i] % BOARD);
+                }
+                removed = true;
+            }
+        }
+    }
+    if (removed) {
+        tiles_refresh(&l->tiles, g);
+        cycle_reset(l->cycle);
+    }
+    return true;
+}
+
+// The board repeats every `period` generations: splits it into objects,
+// the cells connected across all of its phases, and counts each one
+static void settle(lane_t *l, const int period) {
+    memset(l->phases, 0, (size_t) BOARD * WORDS * sizeof(uint64_t));
+    for (int p = 0; p < period; p++) {
+        for (int y = 0; y < BOARD; y++) {
+            const uint64_t *row = grid_row(&l->grid, y);
+            for (int w = 0; w < WORDS; w++) l->phases[y * WORDS + w] |= row[w];
+        }
+        life_step_tiles(&l->grid, &l->next, &l->tiles, 0, l->tiles.rows);
+        const grid_t tmp = l->grid;
+        l->grid = l->next;
+        l->next = tmp;
+        tiles_swap(&l->tiles);
+    }
+
+    load_marks(l, l->phases, WORDS);
+    for (int i = 0; i < BOARD * WORDS; i++) {
+        while (l->marks[i]) {
+            const int n = flood(l, i / WORDS * BOARD + i % WORDS * 64 + life_lowest_bit(l->marks[i]), 1);
+            // Run from the phase the board is in
+            int alive = 0;
+            for (int k = 0; k < n; k++) {
+                if (grid_get(&l->grid, l->cells[k] / BOARD, l->cells[k] % BOARD)) l->cells[alive++] = l->cells[k];
+            }
+            count(l, alive && name(l, alive, period) ? l->name : "zz_UNSEPARATED");
+        }
+    }
+}
+
+// Runs soup `index` until it settles, false if it didn't
+static bool run_soup(lane_t *l, const uint64_t seed, const uint64_t index) {
+    grid_clear(&l->grid);
+    grid_clear(&l->next);
+    const int at = (BOARD - SOUP) / 2;
+    soup_fill(&l->grid, NULL, soup_hash(seed, index), SOUP_DENSITY, at, at + SOUP, at, at + SOUP);
+    tiles_mark_all(&l->tiles);
+    tiles_track(&l->tiles, &l->grid, TILES_HASH);
+    cycle_reset(l->cycle);
+    l->wait = 0;
+
+    for (uint64_t generation = 1; generation <= CENSUS_MAX_GENERATIONS && !l->failed; generation++) {
+        life_step_tiles(&l->grid, &l->next, &l->tiles, 0, l->tiles.rows);
+        const grid_t tmp = l->grid;
+        l->grid = l->next;
+        l->next = tmp;
+        tiles_swap(&l->tiles);
+        if (generation % ESCAPE_EVERY == 0 && l->wait-- <= 0 && !escape(l)) return false;
+        const uint64_t period = cycle_check(l->cycle, l->tiles.hash, generation);
+        if (period) {
+            settle(l, (int) period);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_lanes(void *data, const int begin, const int end) {
+    search_t *s = data;
+    for (int i = begin; i < end; i++) {
+        lane_t lane;
+        if (!lane_create(&lane)) {
+            SDL_AtomicSet(&s->failed, 1);
+            return;
+        }
+        for (;;) {
+            const int n = SDL_AtomicAdd(&s->next, 1);
+            if (n >= s->count || SDL_AtomicGet(&s->failed)) break;
+            lane.soups++;
+            if (!run_soup(&lane, s->seed, s->first + (uint64_t) n)) lane.unsettled++;
+            if (lane.failed) SDL_AtomicSet(&s->failed, 1);
+        }
+
+        SDL_LockMutex(s->lock);
+        census_t *c = s->census;
+        c->soups += lane.soups;
+        c->unsettled += lane.unsettled;
+        for (size_t e = 0; e < lane.table.capacity; e++) {
+            const entry_t *entry = &lane.table.entries[e];
+            if (entry->code && !table_add(&c->table, entry->code, entry->count)) SDL_AtomicSet(&s->failed, 1);
+        }
+        SDL_UnlockMutex(s->lock);
+        lane_destroy(&lane);
+    }
+}
+
+census_t *census_create(void) {
+    return SDL_calloc(1, sizeof(census_t));
+}
+
+void census_destroy(census_t *c) {
+    if (!c) return;
+    table_free(&c->table);
+    SDL_free(c);
+}
+
+bool census_run(census_t *c, pool_t *pool, const uint64_t seed, const uint64_t first, const int count) {
+    search_t s = {c, seed, first, count, {0}, {0}, SDL_CreateMutex()};
+    if (!s.lock) return false;
+    // A lane per thread, each taking soups until there are none left
+    pool_run(pool, run_lanes, &s, pool_threads(pool));
+    SDL_DestroyMutex(s.lock);
+    return !SDL_AtomicGet(&s.failed);
+}
+
+uint64_t census_soups(const census_t *c) {
+    return c->soups;
+}
+
+uint64_t census_unsettled(const census_t *c) {
+    return c->unsettled;
+}
+
+static int by_count(const void *a, const void *b) {
+    const census_object_t *x = a, *y = b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return SDL_strcmp(x->code, y->code);
+}
+
+bool census_objects(const census_t *c, census_object_t **objects, size_t *count) {
+    *count = 0;
+    if (!(*objects = SDL_malloc(SDL_max(c->table.count, 1) * sizeof(census_object_t)))) return false;
+    for (size_t i = 0; i < c->table.capacity; i++) {
+        if (c->table.entries[i].code) (*objects)[(*count)++] = (census_object_t) {c->table.entries[i].code, c->table.entries[i].count};
+    }
+    SDL_qsort(*objects, *count, sizeof(census_object_t), by_count);
+    return true;
+}
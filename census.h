@@ -0,0 +1,54 @@
+#ifndef CENSUS_H
+#define CENSUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pool.h"
+
+// Soup search: runs lots of random 16x16 soups until they settle and
+// counts the objects they leave behind.
+//
+// Every thread of the pool runs a lane, a small board of its own with its
+// own tiles and cycle detector, and takes the next soup off a shared
+// counter whenever it's done with one, so lanes stuck with long lived
+// soups don't hold the rest up. Soup n of a seed is always the same soup
+// and the census the same, however many threads ran it.
+//
+// A soup has settled once the cycle detector sees its board repeat. Ships
+// flying off are taken out when they get near the edge, everything left
+// is split into objects, which are run on their own to find their period
+// and named by their apgcode: xs<cells>_ for still lifes, xp<period>_ for
+// oscillators and xq<period>_ for ships, then the extended Wechsler code
+// of whichever phase and orientation gives the shortest, alphabetically
+// first one (a block is xs4_33, a glider xq4_153). Objects that don't
+// keep going on their own are zz_UNSEPARATED.
+
+typedef struct Census census_t;
+
+typedef struct CensusObject {
+    const char *code;
+    uint64_t count;
+} census_object_t;
+
+// NULL if out of memory.
+census_t *census_create(void);
+void census_destroy(census_t *c);
+
+// Runs soups [first, first + count) of `seed` on every thread of pool,
+// adding what they settle into to c. The rule is life_set_rule()'s, which
+// has to be a two state one, on the plane. False if out of memory.
+bool census_run(census_t *c, pool_t *pool, uint64_t seed, uint64_t first, int count);
+
+uint64_t census_soups(const census_t *c);
+// Soups that hadn't settled after CENSUS_MAX_GENERATIONS or grew past the
+// edge of their board.
+uint64_t census_unsettled(const census_t *c);
+
+// Every object seen, most common first, into *objects (SDL_free() it when
+// done). The codes belong to c. False if out of memory.
+bool census_objects(const census_t *c, census_object_t **objects, size_t *count);
+
+#define CENSUS_MAX_GENERATIONS 32768
+
+#endif
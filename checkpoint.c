@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "checkpoint.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHECKPOINT_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File header: magic, width, height, planes, topology
+#define FILE_MAGIC "GOLCCKP1"
+#define HEADER_BYTES 24
+// Record: magic, flags, generation, rng, birth, survive, states, tiles,
+// payload bytes, then the payload and a checksum of everything before it
+#define RECORD_MAGIC 0x44524352u // "RCRD"
+#define RECORD_BYTES 40
+#define RECORD_FULL 1
+// Tile: index, then per plane a mask of its non-zero rows and those rows
+#define TILE_MAX_BYTES(planes) (4 + (size_t) (planes) * (8 + LIFE_TILE_ROWS * 8))
+// The file is rewritten once the deltas add up to this many first records
+#define REWRITE_RATIO 2
+
+struct Checkpoint {
+    char *path;
+    grid_t shadow;          // the grid as of the last save
+    int tile_cols, tile_rows;
+    uint8_t *dirty;         // per tile, marked since the last save
+
+    // The job the writer works on, save() only fills it while it's idle
+    checkpoint_meta_t meta;
+    uint32_t *tiles;        // indices of the tiles to write
+    uint64_t *words;        // LIFE_TILE_ROWS per plane for each of them
+    uint32_t count;
+    bool job_full;
+
+    SDL_Thread *writer;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    bool pending, quit;
+    bool full;              // the next save starts a fresh file
+    size_t full_bytes, delta_bytes;
+};
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+    v = SDL_SwapLE32(v);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+static uint8_t *put64(uint8_t *p, uint64_t v) {
+    v = SDL_SwapLE64(v);
+    memcpy(p, &v, 8);
+    return p + 8;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return SDL_SwapLE32(v);
+}
+
+static uint64_t get64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return SDL_SwapLE64(v);
+}
+
+// FNV-1a
+static uint64_t checksum(const uint8_t *p, const size_t n) {
+    uint64_t h = UINT64_C(0xCBF29CE484222325);
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * UINT64_C(0x100000001B3);
+    }
+    return h;
+}
+
+// Encodes the pending job, with the file header in front for a full one
+static size_t encode(const checkpoint_t *c, uint8_t **buf, size_t *capacity) {
+    const int planes = c->shadow.planes;
+    const size_t need = HEADER_BYTES + RECORD_BYTES + 8 + c->count * TILE_MAX_BYTES(planes);
+    if (need > *capacity) {
+        uint8_t *grown = SDL_realloc(*buf, need);
+        if (!grown) return 0;
+        *buf = grown;
+        *capacity = need;
+    }
+
+    uint8_t *p = *buf;
+    if (c->job_full) {
+        memcpy(p, FILE_MAGIC, 8);
+        p = put32(p + 8, (uint32_t) c->shadow.width);
+        p = put32(p, (uint32_t) c->shadow.height);
+        p = put32(p, (uint32_t) planes);
+        p = put32(p, (uint32_t) c->meta.topology);
+    }
+
+    uint8_t *record = p, *payload = p + RECORD_BYTES;
+    uint32_t written = 0;
+    p = payload;
+    for (uint32_t t = 0; t < c->count; t++) {
+        const uint64_t *words = c->words + (size_t) t * planes * LIFE_TILE_ROWS;
+        uint64_t any = 0;
+        for (int i = 0; i < planes * LIFE_TILE_ROWS; i++) any |= words[i];
+        // A fresh file starts out empty, deltas have to clear tiles too
+        if (!any && c->job_full) continue;
+
+        p = put32(p, c->tiles[t]);
+        for (int pl = 0; pl < planes; pl++, words += LIFE_TILE_ROWS) {
+            uint64_t mask = 0;
+            for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+                if (words[i]) mask |= UINT64_C(1) << i;
+            }
+            p = put64(p, mask);
+            for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+                if (words[i]) p = put64(p, words[i]);
+            }
+        }
+        written++;
+    }
+
+    const checkpoint_meta_t *m = &c->meta;
+    uint8_t *h = put32(record, RECORD_MAGIC);
+    h = put32(h, c->job_full ? RECORD_FULL : 0);
+    h = put64(h, m->generation);
+    h = put64(h, m->rng);
+    h = put32(h, (uint32_t) m->rule.birth | (uint32_t) m->rule.survive << 16);
+    h = put32(h, (uint32_t) m->rule.states);
+    h = put32(h, written);
+    put32(h, (uint32_t) (p - payload));
+    p = put64(p, checksum(record, (size_t) (p - record)));
+    return (size_t) (p - *buf);
+}
+
+static bool write_file(const char *path, const char *mode, const uint8_t *buf, const size_t bytes) {
+    SDL_RWops *rw = SDL_RWFromFile(path, mode);
+    if (!rw) return false;
+    const bool ok = SDL_RWwrite(rw, buf, 1, bytes) == bytes;
+    return SDL_RWclose(rw) == 0 && ok;
+}
+
+// A full record goes to a new file renamed over the old one, so there is
+// always a complete checkpoint on disk
+static bool write_record(const checkpoint_t *c, const uint8_t *buf, const size_t bytes) {
+    if (!c->job_full) return write_file(c->path, "ab", buf, bytes);
+
+    char tmp[1024];
+    SDL_snprintf(tmp, sizeof(tmp), "%s.tmp", c->path);
+    if (!write_file(tmp, "wb", buf, bytes)) return false;
+#ifdef _WIN32
+    remove(c->path);
+#endif
+    if (rename(tmp, c->path) != 0) {
+        SDL_SetError("Couldn't rename %s", tmp);
+        return false;
+    }
+    return true;
+}
+
+static int writer_main(void *data) {
+    checkpoint_t *c = data;
+    uint8_t *buf = NULL;
+    size_t capacity = 0;
+
+    SDL_LockMutex(c->lock);
+    for (;;) {
+        while (!c->pending && !c->quit) SDL_CondWait(c->cond, c->lock);
+        if (!c->pending) break;
+        SDL_UnlockMutex(c->lock);
+
+        const size_t bytes = encode(c, &buf, &capacity);
+        const bool ok = bytes && write_record(c, buf, bytes);
+        if (!bytes) SDL_OutOfMemory();
+
+        SDL_LockMutex(c->lock);
+        if (!ok) {
+            SDL_Log("Couldn't write checkpoint %s: %s", c->path, SDL_GetError());
+            c->full = true;
+        } else if (c->job_full) {
+            c->full_bytes = bytes;
+            c->delta_bytes = 0;
+        } else {
+            c->delta_bytes += bytes;
+            if (c->delta_bytes > REWRITE_RATIO * c->full_bytes) c->full = true;
+        }
+        c->pending = false;
+        SDL_CondBroadcast(c->cond);
+    }
+    SDL_UnlockMutex(c->lock);
+    SDL_free(buf);
+    return 0;
+}
+
+checkpoint_t *checkpoint_create(const char *path, const grid_t *g) {
+    checkpoint_t *c = SDL_calloc(1, sizeof(*c));
+    if (!c) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    c->full = true;
+    c->tile_cols = g->words;
+    c->tile_rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    const size_t tiles = (size_t) c->tile_cols * c->tile_rows;
+    c->path = SDL_strdup(path);
+    c->dirty = SDL_calloc(tiles, 1);
+    c->tiles = SDL_malloc(tiles * sizeof(uint32_t));
+    c->words = SDL_malloc(tiles * g->planes * LIFE_TILE_ROWS * sizeof(uint64_t));
+    c->lock = SDL_CreateMutex();
+    c->cond = SDL_CreateCond();
+    if (!c->path || !c->dirty || !c->tiles || !c->words || !c->lock || !c->cond
+            || !grid_create_planes(&c->shadow, g->width, g->height, g->planes)) {
+        SDL_OutOfMemory();
+        checkpoint_destroy(c);
+        return NULL;
+    }
+    if (!(c->writer = SDL_CreateThread(writer_main, "golc checkpoint", c))) {
+        checkpoint_destroy(c);
+        return NULL;
+    }
+    return c;
+}
+
+void checkpoint_destroy(checkpoint_t *c) {
+    if (!c) return;
+    if (c->writer) {
+        SDL_LockMutex(c->lock);
+        c->quit = true;
+        SDL_CondBroadcast(c->cond);
+        SDL_UnlockMutex(c->lock);
+        SDL_WaitThread(c->writer, NULL);
+    }
+    if (c->lock) SDL_DestroyMutex(c->lock);
+    if (c->cond) SDL_DestroyCond(c->cond);
+    grid_destroy(&c->shadow);
+    SDL_free(c->path);
+    SDL_free(c->dirty);
+    SDL_free(c->tiles);
+    SDL_free(c->words);
+    SDL_free(c);
+}
+
+void checkpoint_flush(checkpoint_t *c) {
+    SDL_LockMutex(c->lock);
+    while (c->pending) SDL_CondWait(c->cond, c->lock);
+    SDL_UnlockMutex(c->lock);
+}
+
+void checkpoint_mark(checkpoint_t *c, const uint8_t *changed) {
+    const size_t n = (size_t) c->tile_cols * c->tile_rows;
+    for (size_t i = 0; i < n; i++) c->dirty[i] |= changed[i];
+}
+
+// Whether tile (ty, tx) of g differs from the shadow
+static bool tile_differs(const checkpoint_t *c, const grid_t *g, const int ty, const int tx) {
+    const int y0 = ty * LIFE_TILE_ROWS, y1 = SDL_min(y0 + LIFE_TILE_ROWS, g->height);
+    uint64_t diff = 0;
+    for (int p = 0; p < g->planes; p++) {
+        for (int y = y0; y < y1; y++) diff |= grid_plane_row(g, p, y)[tx] ^ grid_plane_row(&c->shadow, p, y)[tx];
+    }
+    return diff != 0;
+}
+
+// Copies tile (ty, tx) of g into the job and the shadow
+static void take_tile(checkpoint_t *c, const grid_t *g, const int ty, const int tx) {
+    uint64_t *out = c->words + (size_t) c->count * g->planes * LIFE_TILE_ROWS;
+    c->tiles[c->count++] = (uint32_t) (ty * c->tile_cols + tx);
+    for (int p = 0; p < g->planes; p++) {
+        for (int i = 0; i < LIFE_TILE_ROWS; i++, out++) {
+            const int y = ty * LIFE_TILE_ROWS + i;
+            *out = y < g->height ? grid_plane_row(g, p, y)[tx] : 0;
+            if (y < g->height) grid_plane_row(&c->shadow, p, y)[tx] = *out;
+        }
+    }
+}
+
+bool checkpoint_save(checkpoint_t *c, const grid_t *g, const checkpoint_meta_t *meta) {
+    SDL_LockMutex(c->lock);
+    const bool busy = c->pending, full = c->full;
+    SDL_UnlockMutex(c->lock);
+    if (busy) return false;
+
+    // Only the marked tiles can differ from the shadow, and some of those
+    // changed back since
+    c->count = 0;
+    for (int ty = 0; ty < c->tile_rows; ty++) {
+        uint8_t *dirty = c->dirty + (size_t) ty * c->tile_cols;
+        for (int tx = 0; tx < c->tile_cols; tx++) {
+            if (full || (dirty[tx] && tile_differs(c, g, ty, tx))) take_tile(c, g, ty, tx);
+            dirty[tx] = 0;
+        }
+    }
+
+    c->meta = *meta;
+    c->meta.width = g->width;
+    c->meta.height = g->height;
+    c->meta.planes = g->planes;
+    c->job_full = full;
+
+    SDL_LockMutex(c->lock);
+    c->full = false;
+    c->pending = true;
+    SDL_CondBroadcast(c->cond);
+    SDL_UnlockMutex(c->lock);
+    return true;
+}
+
+typedef struct Mapped {
+    const uint8_t *data;
+    size_t size;
+    void *loaded;           // SDL_LoadFile() fallback
+} mapped_t;
+
+static bool map_file(const char *path, mapped_t *m) {
+    memset(m, 0, sizeof(*m));
+#ifdef CHECKPOINT_MMAP
+    struct stat st;
+    const int fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            SDL_SetError("Couldn't map %s", path);
+            return false;
+        }
+        m->data = data;
+        m->size = (size_t) st.st_size;
+        return true;
+    }
+    if (fd >= 0) close(fd);
+#endif
+    m->loaded = SDL_LoadFile(path, &m->size);
+    m->data = m->loaded;
+    return m->loaded != NULL;
+}
+
+static void unmap_file(mapped_t *m) {
+#ifdef CHECKPOINT_MMAP
+    if (!m->loaded && m->data) munmap((void *) m->data, m->size);
+#endif
+    SDL_free(m->loaded);
+}
+
+// Applies a record's tiles to g, false if they don't fit it
+static bool apply(const uint8_t *p, const uint8_t *end, const uint32_t tiles, grid_t *g) {
+    const int cols = g->words, rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    for (uint32_t t = 0; t < tiles; t++) {
+        if (end - p < 4) return false;
+        const uint32_t index = get32(p);
+        p += 4;
+        if (index >= (uint32_t) cols * (uint32_t) rows) return false;
+        const int ty = (int) (index / (uint32_t) cols), tx = (int) (index % (uint32_t) cols);
+
+        for (int pl = 0; pl < g->planes; pl++) {
+            if (end - p < 8) return false;
+            const uint64_t mask = get64(p);
+            p += 8;
+            for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+                uint64_t word = 0;
+                if (mask >> i & 1) {
+                    if (end - p < 8) return false;
+                    word = get64(p);
+                    p += 8;
+                }
+                const int y = ty * LIFE_TILE_ROWS + i;
+                if (y < g->height) grid_plane_row(g, pl, y)[tx] = word;
+            }
+        }
+    }
+    return true;
+}
+
+// Replays a mapped file into g (if not NULL) and meta
+static bool replay(const char *path, const uint8_t *p, const uint8_t *end, grid_t *g, checkpoint_meta_t *meta) {
+    if (end - p < HEADER_BYTES || memcmp(p, FILE_MAGIC, 8) != 0) {
+        SDL_SetError("%s isn't a checkpoint", path);
+        return false;
+    }
+    checkpoint_meta_t last = {0};
+    last.width = (int) get32(p + 8);
+    last.height = (int) get32(p + 12);
+    last.planes = (int) get32(p + 16);
+    last.topology = (topology_t) get32(p + 20);
+    if (get32(p + 20) >= TOPOLOGIES) {
+        SDL_SetError("%s has an unknown topology", path);
+        return false;
+    }
+    if (g && (g->width != last.width || g->height != last.height || g->planes != last.planes)) {
+        SDL_SetError("%s is a %d x %d checkpoint with %d planes", path, last.width, last.height, last.planes);
+        return false;
+    }
+    if (g) grid_clear(g);
+
+    // Stop at the first record that is cut short or doesn't add up
+    bool ok = false;
+    for (p += HEADER_BYTES; end - p >= RECORD_BYTES + 8; ) {
+        const uint32_t payload = get32(p + 36);
+        if (get32(p) != RECORD_MAGIC || (size_t) (end - p) - RECORD_BYTES - 8 < payload) break;
+        const uint8_t *sum = p + RECORD_BYTES + payload;
+        if (get64(sum) != checksum(p, (size_t) (sum - p))) break;
+        if (g && !apply(p + RECORD_BYTES, sum, get32(p + 32), g)) break;
+
+        last.generation = get64(p + 8);
+        last.rng = get64(p + 16);
+        last.rule.birth = (uint16_t) get32(p + 24);
+        last.rule.survive = (uint16_t) (get32(p + 24) >> 16);
+        last.rule.states = (int) get32(p + 28);
+        ok = true;
+        p = sum + 8;
+    }
+    if (!ok) SDL_SetError("%s holds no complete checkpoint", path);
+    *meta = last;
+    return ok;
+}
+
+static bool replay_file(const char *path, grid_t *g, checkpoint_meta_t *meta) {
+    mapped_t m;
+    if (!map_file(path, &m)) return false;
+    const bool ok = replay(path, m.data, m.data + m.size, g, meta);
+    unmap_file(&m);
+    return ok;
+}
+
+bool checkpoint_read_meta(const char *path, checkpoint_meta_t *meta) {
+    return replay_file(path, NULL, meta);
+}
+
+bool checkpoint_restore(const char *path, grid_t *g, checkpoint_meta_t *meta) {
+    return replay_file(path, g, meta);
+}
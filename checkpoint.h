@@ -0,0 +1,55 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "life.h"
+#include "rule.h"
+
+// Incremental checkpoints of a running board.
+//
+// A checkpoint file is a header followed by records. The first record holds
+// every tile of the grid, each later one only the tiles that changed since
+// the record before it, so restoring replays them in order. Tiles are the
+// 64x64 ones of life_step_tiles(), stored as a mask of their non-zero words
+// followed by those words. Every record ends in a checksum and a torn one
+// at the end of the file (the process died mid-write) is ignored.
+//
+// Saving only diffs and copies the tiles marked as changed since the last
+// save, a background thread encodes and writes them. Once the deltas
+// outgrow the first record the file is rewritten from scratch next to it
+// and renamed over it.
+// Errors are reported through SDL_GetError(), or logged by the writer.
+
+typedef struct CheckpointMeta {
+    int width, height, planes;
+    topology_t topology;
+    uint64_t generation;
+    rule_t rule;
+    uint64_t rng;
+} checkpoint_meta_t;
+
+typedef struct Checkpoint checkpoint_t;
+
+// Checkpoints of grids shaped like g to `path`, NULL if out of memory or
+// the writer thread couldn't start.
+checkpoint_t *checkpoint_create(const char *path, const grid_t *g);
+// Waits for the last save to hit the disk.
+void checkpoint_destroy(checkpoint_t *c);
+
+// Remembers the tiles flagged in `changed` (laid out like tiles_t) as
+// needing a look at the next save.
+void checkpoint_mark(checkpoint_t *c, const uint8_t *changed);
+// Queues the marked tiles that changed since the last save and returns right
+// away, or returns false without queueing anything if the previous save
+// is still being written.
+bool checkpoint_save(checkpoint_t *c, const grid_t *g, const checkpoint_meta_t *meta);
+void checkpoint_flush(checkpoint_t *c);
+
+// Reads the newest complete checkpoint in the file: just its meta data, or
+// the grid too, which must have the width, height and planes it names.
+// Regular files are mapped instead of read.
+bool checkpoint_read_meta(const char *path, checkpoint_meta_t *meta);
+bool checkpoint_restore(const char *path, grid_t *g, checkpoint_meta_t *meta);
+
+#endif
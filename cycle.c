@@ -0,0 +1,80 @@
+#include <stdbool.h>
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "cycle.h"
+
+typedef struct Slot {
+    uint64_t hash, generation;
+    bool used;
+} slot_t;
+
+struct Cycle {
+    int max_period;
+    slot_t *slots;          // at most half full
+    size_t mask, used;
+    slot_t *recent;         // the last max_period generations, a ring
+    uint64_t count;
+};
+
+cycle_t *cycle_create(const int max_period) {
+    cycle_t *c = SDL_calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->max_period = SDL_max(max_period, 1);
+    size_t size = 1;
+    while (size < 4 * (size_t) c->max_period) size *= 2;
+    c->mask = size - 1;
+    c->slots = SDL_calloc(size, sizeof(*c->slots));
+    c->recent = SDL_calloc((size_t) c->max_period, sizeof(*c->recent));
+    if (!c->slots || !c->recent) {
+        cycle_destroy(c);
+        return NULL;
+    }
+    return c;
+}
+
+void cycle_destroy(cycle_t *c) {
+    if (!c) return;
+    SDL_free(c->slots);
+    SDL_free(c->recent);
+    SDL_free(c);
+}
+
+void cycle_reset(cycle_t *c) {
+    memset(c->slots, 0, (c->mask + 1) * sizeof(*c->slots));
+    c->used = 0;
+    c->count = 0;
+}
+
+// Points hash at generation, returns the generation it pointed at before
+// or generation itself if it's new
+static uint64_t insert(cycle_t *c, const uint64_t hash, const uint64_t generation) {
+    size_t i = hash & c->mask;
+    while (c->slots[i].used) {
+        if (c->slots[i].hash == hash) {
+            const uint64_t last = c->slots[i].generation;
+            c->slots[i].generation = generation;
+            return last;
+        }
+        i = (i + 1) & c->mask;
+    }
+    c->slots[i] = (slot_t) {.hash = hash, .generation = generation, .used = true};
+    c->used++;
+    return generation;
+}
+
+uint64_t cycle_check(cycle_t *c, const uint64_t hash, const uint64_t generation) {
+    const uint64_t last = insert(c, hash, generation);
+    c->recent[c->count++ % c->max_period] = (slot_t) {.hash = hash, .generation = generation, .used = true};
+
+    // Generations older than max_period only take up room, once they fill
+    // the table start over from the recent ones, oldest first
+    if (c->used >= 2 * (size_t) c->max_period) {
+        memset(c->slots, 0, (c->mask + 1) * sizeof(*c->slots));
+        c->used = 0;
+        for (uint64_t i = c->count - SDL_min(c->count, (uint64_t) c->max_period); i < c->count; i++) {
+            const slot_t *s = &c->recent[i % c->max_period];
+            insert(c, s->hash, s->generation);
+        }
+    }
+    return generation - last <= (uint64_t) c->max_period ? generation - last : 0;
+}
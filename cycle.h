@@ -0,0 +1,25 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <stdint.h>
+
+// Tells when a board has settled into a still life or an oscillator, from
+// the hash of every generation (tiles_t.hash). The hashes of the last
+// max_period generations are kept in a small open addressed table, so a
+// board that repeats is caught the first time it comes around.
+
+typedef struct Cycle cycle_t;
+
+// NULL if out of memory.
+cycle_t *cycle_create(int max_period);
+void cycle_destroy(cycle_t *c);
+
+// Forgets every generation seen so far, the board was edited.
+void cycle_reset(cycle_t *c);
+
+// Remembers hash as the board at generation, which has to come after the
+// last one checked. Returns how many generations ago the board looked the
+// same if that's at most max_period back (1 for a still life), else 0.
+uint64_t cycle_check(cycle_t *c, uint64_t hash, uint64_t generation);
+
+#endif
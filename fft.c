@@ -0,0 +1,397 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "fft.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FFT_X86_SIMD 1
+#endif
+
+// Spectrum columns a column job transforms together: a couple of vectors,
+// narrow enough that the stripe stays in cache through all the stages
+#define STRIPE 16
+
+// a, b = a + w b, a - w b on split complex numbers
+static inline void butterfly(float *ar, float *ai, float *br, float *bi, const float wr, const float wi) {
+    const float tr = *br * wr - *bi * wi, ti = *br * wi + *bi * wr;
+    *br = *ar - tr;
+    *bi = *ai - ti;
+    *ar += tr;
+    *ai += ti;
+}
+
+// Defines the butterflies of a stage on n pairs, `sizeof(T) / 4` at a time.
+// Loads and stores go through memcpy like the life kernels.
+// spread: a twiddle per pair, within a row.
+// shared: one twiddle for all of them, two rows of the spectrum.
+// multiply: pointwise complex products.
+#define FFT_KERNELS(suffix, T, attr)                                        \
+attr static void spread_##suffix(float *ar, float *ai, float *br, float *bi, const float *wr, const float *wi, const int n) { \
+    const int lanes = (int) (sizeof(T) / sizeof(float));                   \
+    int i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                    \
+        T xr, xi, yr, yi, cr, ci;                                           \
+        memcpy(&xr, ar + i, sizeof(T));                                     \
+        memcpy(&xi, ai + i, sizeof(T));                                     \
+        memcpy(&yr, br + i, sizeof(T));                                     \
+        memcpy(&yi, bi + i, sizeof(T));                                     \
+        memcpy(&cr, wr + i, sizeof(T));                                     \
+        memcpy(&ci, wi + i, sizeof(T));                                     \
+        const T tr = yr * cr - yi * ci, ti = yr * ci + yi * cr;             \
+        const T r0 = xr + tr, i0 = xi + ti, r1 = xr - tr, i1 = xi - ti;     \
+        memcpy(ar + i, &r0, sizeof(T));                                     \
+        memcpy(ai + i, &i0, sizeof(T));                                     \
+        memcpy(br + i, &r1, sizeof(T));                                     \
+        memcpy(bi + i, &i1, sizeof(T));                                     \
+    }                                                                       \
+    for (; i < n; i++) butterfly(ar + i, ai + i, br + i, bi + i, wr[i], wi[i]); \
+}                                                                           \
+attr static void shared_##suffix(float *ar, float *ai, float *br, float *bi, const float wr, const float wi, const int n) { \
+    const int lanes = (int) (sizeof(T) / sizeof(float));                   \
+    int i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                    \
+        T xr, xi, yr, yi;                                                   \
+        memcpy(&xr, ar + i, sizeof(T));                                     \
+        memcpy(&xi, ai + i, sizeof(T));                                     \
+        memcpy(&yr, br + i, sizeof(T));                                     \
+        memcpy(&yi, bi + i, sizeof(T));                                     \
+        const T tr = yr * wr - yi * wi, ti = yr * wi + yi * wr;             \
+        const T r0 = xr + tr, i0 = xi + ti, r1 = xr - tr, i1 = xi - ti;     \
+        memcpy(ar + i, &r0, sizeof(T));                                     \
+        memcpy(ai + i, &i0, sizeof(T));                                     \
+        memcpy(br + i, &r1, sizeof(T));                                     \
+        memcpy(bi + i, &i1, sizeof(T));                                     \
+    }                                                                       \
+    for (; i < n; i++) butterfly(ar + i, ai + i, br + i, bi + i, wr, wi);   \
+}                                                                           \
+attr static void multiply_##suffix(float *re, float *im, const float *kr, const float *ki, const int n) { \
+    const int lanes = (int) (sizeof(T) / sizeof(float));                   \
+    int i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                    \
+        T a, b, c, d;                                                       \
+        memcpy(&a, re + i, sizeof(T));                                      \
+        memcpy(&b, im + i, sizeof(T));                                      \
+        memcpy(&c, kr + i, sizeof(T));                                      \
+        memcpy(&d, ki + i, sizeof(T));                                      \
+        const T r = a * c - b * d, j = a * d + b * c;                       \
+        memcpy(re + i, &r, sizeof(T));                                      \
+        memcpy(im + i, &j, sizeof(T));                                      \
+    }                                                                       \
+    for (; i < n; i++) {                                                    \
+        const float r = re[i] * kr[i] - im[i] * ki[i];                      \
+        im[i] = re[i] * ki[i] + im[i] * kr[i];                              \
+        re[i] = r;                                                          \
+    }                                                                       \
+}
+
+typedef void (*spread_t)(float *ar, float *ai, float *br, float *bi, const float *wr, const float *wi, int n);
+typedef void (*shared_t)(float *ar, float *ai, float *br, float *bi, float wr, float wi, int n);
+typedef void (*multiply_t)(float *re, float *im, const float *kr, const float *ki, int n);
+
+typedef struct Kernels {
+    const char *name;
+    spread_t spread;
+    shared_t shared;
+    multiply_t multiply;
+} kernels_t;
+
+FFT_KERNELS(scalar, float, )
+#ifdef FFT_X86_SIMD
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v8f __attribute__((vector_size(32)));
+FFT_KERNELS(sse2, v4f, __attribute__((target("sse2"))))
+FFT_KERNELS(avx2, v8f, __attribute__((target("avx2"))))
+#endif
+
+static const kernels_t kernels[] = {
+    {"scalar", spread_scalar, shared_scalar, multiply_scalar},
+#ifdef FFT_X86_SIMD
+    {"sse2", spread_sse2, shared_sse2, multiply_sse2},
+    {"avx2", spread_avx2, shared_avx2, multiply_avx2},
+#endif
+};
+
+// A complex transform of size n: where bit reversal puts each element, and
+// the twiddles of every stage, e^(-i pi j / s) for j < s at s - 1 on
+typedef struct Plan {
+    int n;
+    int *reverse;
+    float *cos, *sin, *sin_inverse;
+} plan_t;
+
+struct Fft {
+    int width, height;
+    int half;           // spectrum rows hold half + 1 numbers
+    int stride;
+    plan_t rows, cols;  // rows are packed into half as many complex numbers
+    // e^(-2 pi i k / width) for k up to half / 2, untangling the packed rows
+    float *untangle_re, *untangle_im;
+    const kernels_t *k;
+    pool_t *pool;
+};
+
+static bool power_of_two(const int n) {
+    return n >= 2 && (n & (n - 1)) == 0;
+}
+
+static void plan_destroy(plan_t *p) {
+    SDL_free(p->reverse);
+    SDL_free(p->cos);
+    SDL_free(p->sin);
+    SDL_free(p->sin_inverse);
+    memset(p, 0, sizeof(*p));
+}
+
+static bool plan_create(plan_t *p, const int n) {
+    memset(p, 0, sizeof(*p));
+    p->n = n;
+    p->reverse = SDL_malloc((size_t) n * sizeof(int));
+    p->cos = SDL_malloc((size_t) n * sizeof(float));
+    p->sin = SDL_malloc((size_t) n * sizeof(float));
+    p->sin_inverse = SDL_malloc((size_t) n * sizeof(float));
+    if (!p->reverse || !p->cos || !p->sin || !p->sin_inverse) {
+        plan_destroy(p);
+        return false;
+    }
+    int bits = 0;
+    while (1 << bits < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) r |= (i >> b & 1) << (bits - 1 - b);
+        p->reverse[i] = r;
+    }
+    for (int s = 1; s < n; s *= 2) {
+        for (int j = 0; j < s; j++) {
+            const double angle = -M_PI * j / s;
+            p->cos[s - 1 + j] = (float) SDL_cos(angle);
+            p->sin[s - 1 + j] = (float) SDL_sin(angle);
+            p->sin_inverse[s - 1 + j] = -p->sin[s - 1 + j];
+        }
+    }
+    return true;
+}
+
+// Radix 2 decimation in time, in place
+static void transform(const kernels_t *k, const plan_t *p, float *re, float *im, const bool inverse) {
+    const int n = p->n;
+    for (int i = 0; i < n; i++) {
+        const int j = p->reverse[i];
+        if (i >= j) continue;
+        const float r = re[i], m = im[i];
+        re[i] = re[j];
+        im[i] = im[j];
+        re[j] = r;
+        im[j] = m;
+    }
+    // The first stage's twiddles are all 1
+    for (int i = 0; i + 1 < n; i += 2) butterfly(re + i, im + i, re + i + 1, im + i + 1, 1, 0);
+    const float *sin = inverse ? p->sin_inverse : p->sin;
+    for (int s = 2; s < n; s *= 2) {
+        for (int g = 0; g < n; g += 2 * s) {
+            k->spread(re + g, im + g, re + g + s, im + g + s, p->cos + s - 1, sin + s - 1, s);
+        }
+    }
+}
+
+typedef struct Job {
+    fft_t *f;
+    const float *in;
+    float *out;
+    spectrum_t *s;
+    const spectrum_t *by;
+    bool inverse;
+} job_t;
+
+// The even cells of a row go in the real parts and the odd ones in the
+// imaginary parts. Transformed, that's Z = E + iO for the transforms E and
+// O of either half, which the row's is E + wO of
+static void forward_rows(void *data, const int y0, const int y1) {
+    const job_t *job = data;
+    const fft_t *f = job->f;
+    const int half = f->half;
+    for (int y = y0; y < y1; y++) {
+        const float *in = job->in + (size_t) y * f->width;
+        float *re = job->s->re + (size_t) y * f->stride, *im = job->s->im + (size_t) y * f->stride;
+        for (int n = 0; n < half; n++) {
+            re[n] = in[2 * n];
+            im[n] = in[2 * n + 1];
+        }
+        transform(f->k, &f->rows, re, im, false);
+
+        // E and O are real at 0, and Z wraps around at half
+        const float r0 = re[0], i0 = im[0];
+        re[0] = r0 + i0;
+        re[half] = r0 - i0;
+        im[0] = im[half] = 0;
+        // E(k) and O(k) come from Z(k) and Z(half - k), and so does
+        // the spectrum at both
+        for (int k = 1; k <= half / 2; k++) {
+            const int l = half - k;
+            const float zr = re[k], zi = im[k], cr = re[l], ci = -im[l];
+            const float er = (zr + cr) / 2, ei = (zi + ci) / 2;
+            const float odd_r = (zi - ci) / 2, odd_i = (cr - zr) / 2;
+            const float wr = f->untangle_re[k], wi = f->untangle_im[k];
+            const float tr = odd_r * wr - odd_i * wi, ti = odd_r * wi + odd_i * wr;
+            re[k] = er + tr;
+            im[k] = ei + ti;
+            re[l] = er - tr;
+            im[l] = ti - ei;
+        }
+    }
+}
+
+// forward_rows() undone, with the halves left out of E and O so that the
+// whole inverse comes out scaled by width * height
+static void inverse_rows(void *data, const int y0, const int y1) {
+    const job_t *job = data;
+    const fft_t *f = job->f;
+    const int half = f->half;
+    for (int y = y0; y < y1; y++) {
+        float *re = job->s->re + (size_t) y * f->stride, *im = job->s->im + (size_t) y * f->stride;
+        const float r0 = re[0], rh = re[half];
+        re[0] = r0 + rh;
+        im[0] = r0 - rh;
+        for (int k = 1; k <= half / 2; k++) {
+            const int l = half - k;
+            const float xr = re[k], xi = im[k], cr = re[l], ci = -im[l];
+            const float er = xr + cr, ei = xi + ci, dr = xr - cr, di = xi - ci;
+            const float wr = f->untangle_re[k], wi = f->untangle_im[k];
+            const float odd_r = dr * wr + di * wi, odd_i = di * wr - dr * wi;
+            re[k] = er - odd_i;
+            im[k] = ei + odd_r;
+            re[l] = er + odd_i;
+            im[l] = odd_r - ei;
+        }
+        transform(f->k, &f->rows, re, im, true);
+
+        float *out = job->out + (size_t) y * f->width;
+        for (int n = 0; n < half; n++) {
+            out[2 * n] = re[n];
+            out[2 * n + 1] = im[n];
+        }
+    }
+}
+
+// Transforms the columns of stripes [s0, s1) down the spectrum
+static void columns(void *data, const int s0, const int s1) {
+    const job_t *job = data;
+    const fft_t *f = job->f;
+    const plan_t *p = &f->cols;
+    const float *sin = job->inverse ? p->sin_inverse : p->sin;
+    for (int stripe = s0; stripe < s1; stripe++) {
+        const int c0 = stripe * STRIPE, n = SDL_min(STRIPE, f->half + 1 - c0);
+        float *re = job->s->re + c0, *im = job->s->im + c0;
+        const size_t stride = (size_t) f->stride;
+        for (int i = 0; i < p->n; i++) {
+            const int j = p->reverse[i];
+            if (i >= j) continue;
+            float tmp[STRIPE];
+            memcpy(tmp, re + i * stride, (size_t) n * sizeof(float));
+            memcpy(re + i * stride, re + j * stride, (size_t) n * sizeof(float));
+            memcpy(re + j * stride, tmp, (size_t) n * sizeof(float));
+            memcpy(tmp, im + i * stride, (size_t) n * sizeof(float));
+            memcpy(im + i * stride, im + j * stride, (size_t) n * sizeof(float));
+            memcpy(im + j * stride, tmp, (size_t) n * sizeof(float));
+        }
+        for (int s = 1; s < p->n; s *= 2) {
+            for (int g = 0; g < p->n; g += 2 * s) {
+                for (int j = 0; j < s; j++) {
+                    const size_t a = (size_t) (g + j) * stride, b = a + (size_t) s * stride;
+                    f->k->shared(re + a, im + a, re + b, im + b, p->cos[s - 1 + j], sin[s - 1 + j], n);
+                }
+            }
+        }
+    }
+}
+
+static void multiply(void *data, const int y0, const int y1) {
+    const job_t *job = data;
+    const fft_t *f = job->f;
+    for (int y = y0; y < y1; y++) {
+        const size_t at = (size_t) y * f->stride;
+        f->k->multiply(job->s->re + at, job->s->im + at, job->by->re + at, job->by->im + at, f->half + 1);
+    }
+}
+
+static int stripes(const fft_t *f) {
+    return (f->half + 1 + STRIPE - 1) / STRIPE;
+}
+
+fft_t *fft_create(const int width, const int height, pool_t *pool) {
+    if (!power_of_two(width) || !power_of_two(height)) {
+        SDL_SetError("FFT sizes have to be powers of two, not %d x %d", width, height);
+        return NULL;
+    }
+    fft_t *f = SDL_calloc(1, sizeof(fft_t));
+    if (!f) return NULL;
+    f->width = width;
+    f->height = height;
+    f->half = width / 2;
+    f->stride = (f->half + 1 + 7) & ~7;
+    f->pool = pool;
+    f->k = &kernels[0];
+#ifdef FFT_X86_SIMD
+    if (SDL_HasAVX2()) f->k = &kernels[2];
+    else if (SDL_HasSSE2()) f->k = &kernels[1];
+#endif
+    f->untangle_re = SDL_malloc((size_t) (f->half / 2 + 1) * sizeof(float));
+    f->untangle_im = SDL_malloc((size_t) (f->half / 2 + 1) * sizeof(float));
+    if (!f->untangle_re || !f->untangle_im || !plan_create(&f->rows, f->half) || !plan_create(&f->cols, height)) {
+        fft_destroy(f);
+        return NULL;
+    }
+    for (int k = 0; k <= f->half / 2; k++) {
+        const double angle = -2 * M_PI * k / width;
+        f->untangle_re[k] = (float) SDL_cos(angle);
+        f->untangle_im[k] = (float) SDL_sin(angle);
+    }
+    return f;
+}
+
+void fft_destroy(fft_t *f) {
+    if (!f) return;
+    plan_destroy(&f->rows);
+    plan_destroy(&f->cols);
+    SDL_free(f->untangle_re);
+    SDL_free(f->untangle_im);
+    SDL_free(f);
+}
+
+int fft_stride(const fft_t *f) {
+    return f->stride;
+}
+
+const char *fft_kernel_name(const fft_t *f) {
+    return f->k->name;
+}
+
+bool fft_spectrum_create(const fft_t *f, spectrum_t *s) {
+    const size_t n = (size_t) f->height * f->stride;
+    s->re = SDL_calloc(n, sizeof(float));
+    s->im = SDL_calloc(n, sizeof(float));
+    if (s->re && s->im) return true;
+    fft_spectrum_destroy(s);
+    return false;
+}
+
+void fft_spectrum_destroy(spectrum_t *s) {
+    SDL_free(s->re);
+    SDL_free(s->im);
+    s->re = s->im = NULL;
+}
+
+void fft_forward(fft_t *f, const float *in, spectrum_t *out) {
+    job_t job = {.f = f, .in = in, .s = out};
+    pool_run(f->pool, forward_rows, &job, f->height);
+    pool_run(f->pool, columns, &job, stripes(f));
+}
+
+void fft_inverse(fft_t *f, spectrum_t *in, float *out) {
+    job_t job = {.f = f, .out = out, .s = in, .inverse = true};
+    pool_run(f->pool, columns, &job, stripes(f));
+    pool_run(f->pool, inverse_rows, &job, f->height);
+}
+
+void fft_multiply(fft_t *f, spectrum_t *s, const spectrum_t *by) {
+    job_t job = {.f = f, .s = s, .by = by};
+    pool_run(f->pool, multiply, &job, f->height);
+}
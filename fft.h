@@ -0,0 +1,46 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdbool.h>
+#include "pool.h"
+
+// 2D FFTs of real arrays on the cpu, for convolving a board with a kernel
+// bigger than stepping cell by cell could afford.
+//
+// Sizes are powers of two. A width x height real array transforms into a
+// half spectrum of height rows of width / 2 + 1 complex numbers, the rest
+// being their mirror image, held as separate real and imaginary arrays so
+// butterflies work on whole vectors of them.
+//
+// Rows go first: each one is packed into a complex row half as long,
+// transformed (radix 2) and untangled into the spectrum's row. The columns
+// are then transformed side by side a stripe at a time: every butterfly
+// combines two spectrum rows with a single twiddle, a vector op across the
+// stripe. Rows and stripes are spread over the pool. Twiddles and the bit
+// reversal are worked out once in fft_create().
+
+typedef struct Fft fft_t;
+
+typedef struct Spectrum {
+    float *re, *im;     // height rows fft_stride() floats apart
+} spectrum_t;
+
+// NULL if a size isn't a power of two of at least 2 or out of memory.
+// Uses the widest vectors the cpu has, like the life kernels.
+fft_t *fft_create(int width, int height, pool_t *pool);
+void fft_destroy(fft_t *f);
+int fft_stride(const fft_t *f);
+const char *fft_kernel_name(const fft_t *f);
+
+bool fft_spectrum_create(const fft_t *f, spectrum_t *s);
+void fft_spectrum_destroy(spectrum_t *s);
+
+// `in` is width x height floats row by row.
+void fft_forward(fft_t *f, const float *in, spectrum_t *out);
+// Back into `out`, scaled up by width * height as it isn't normalized.
+// Overwrites `in`.
+void fft_inverse(fft_t *f, spectrum_t *in, float *out);
+// s *= by, pointwise: a convolution with whatever `by` is the spectrum of.
+void fft_multiply(fft_t *f, spectrum_t *s, const spectrum_t *by);
+
+#endif
@@ -0,0 +1,519 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "hashlife.h"
+
+// Leaves are 8x8 blocks, bit 8 * y + x of `bits` is cell (y, x)
+#define LEAF_LEVEL 3
+// The root never shrinks below this so centered() can look at grandchildren
+#define MIN_ROOT_LEVEL 5
+#define MAX_STEP 48
+#define MAX_LEVEL 64
+#define SLAB_NODES 4096
+#define DEFAULT_MAX_NODES ((size_t) 1 << 22)
+
+typedef struct Node node_t;
+struct Node {
+    node_t *nw, *ne, *sw, *se;  // all NULL for leaves
+    node_t *result;             // memoized center after 2^step generations
+    node_t *next;               // hash chain, or free list
+    uint64_t bits;              // leaf cells
+    uint64_t population;
+    uint32_t hash;
+    int8_t level;
+    int8_t step;                // exponent `result` was computed for
+    uint8_t mark;
+};
+
+typedef struct Slab {
+    struct Slab *next;
+    node_t nodes[SLAB_NODES];
+} slab_t;
+
+struct HashLife {
+    node_t **buckets;
+    size_t bucket_count;        // power of two
+    size_t count;               // live nodes in the table
+    size_t max_nodes;
+    node_t *free_list;
+    slab_t *slabs;
+
+    node_t *empty[MAX_LEVEL];
+    node_t *root;
+    int64_t origin;             // the root covers [-origin, origin) on both axes
+    uint64_t generation;
+    uint16_t birth, survive;    // see rule.h
+};
+
+static uint64_t add_sat(const uint64_t a, const uint64_t b) {
+    return a + b < a ? UINT64_MAX : a + b;
+}
+
+static uint32_t hash_leaf(const uint64_t bits) {
+    const uint64_t h = bits * UINT64_C(0x9E3779B97F4A7C15);
+    return (uint32_t) (h >> 32) ^ (uint32_t) h;
+}
+
+static uint32_t hash_children(const node_t *nw, const node_t *ne, const node_t *sw, const node_t *se) {
+    uint64_t h = (uintptr_t) nw;
+    h = h * UINT64_C(0x100000001B3) + (uintptr_t) ne;
+    h = h * UINT64_C(0x100000001B3) + (uintptr_t) sw;
+    h = h * UINT64_C(0x100000001B3) + (uintptr_t) se;
+    h ^= h >> 29;
+    h *= UINT64_C(0xBF58476D1CE4E5B9);
+    return (uint32_t) (h >> 32);
+}
+
+// NULL if out of memory. So is every node made from a NULL one, all the
+// way up to whatever asked for it, which then leaves the universe as it was
+static node_t *alloc_node(hashlife_t *hl) {
+    if (!hl->free_list) {
+        slab_t *slab = SDL_malloc(sizeof(slab_t));
+        if (!slab) return NULL;
+        slab->next = hl->slabs;
+        hl->slabs = slab;
+        for (int i = SLAB_NODES - 1; i >= 0; i--) {
+            slab->nodes[i].next = hl->free_list;
+            hl->free_list = &slab->nodes[i];
+        }
+    }
+    node_t *n = hl->free_list;
+    hl->free_list = n->next;
+    return n;
+}
+
+static void rehash(hashlife_t *hl, const size_t bucket_count) {
+    node_t **buckets = SDL_calloc(bucket_count, sizeof(node_t *));
+    if (!buckets) return; // keep the old table, chains just get longer
+
+    for (size_t i = 0; i < hl->bucket_count; i++) {
+        node_t *n = hl->buckets[i];
+        while (n) {
+            node_t *next = n->next;
+            node_t **slot = &buckets[n->hash & (bucket_count - 1)];
+            n->next = *slot;
+            *slot = n;
+            n = next;
+        }
+    }
+    SDL_free(hl->buckets);
+    hl->buckets = buckets;
+    hl->bucket_count = bucket_count;
+}
+
+static node_t *insert(hashlife_t *hl, node_t *n) {
+    if (hl->count >= hl->bucket_count) rehash(hl, hl->bucket_count * 2);
+    node_t **slot = &hl->buckets[n->hash & (hl->bucket_count - 1)];
+    n->next = *slot;
+    *slot = n;
+    hl->count++;
+    return n;
+}
+
+static node_t *leaf(hashlife_t *hl, const uint64_t bits) {
+    const uint32_t hash = hash_leaf(bits);
+    for (node_t *n = hl->buckets[hash & (hl->bucket_count - 1)]; n; n = n->next) {
+        if (n->level == LEAF_LEVEL && n->bits == bits) return n;
+    }
+
+    node_t *n = alloc_node(hl);
+    if (!n) return NULL;
+    memset(n, 0, sizeof(*n));
+    n->bits = bits;
+    n->population = (uint64_t) life_popcount(bits);
+    n->hash = hash;
+    n->level = LEAF_LEVEL;
+    n->step = -1;
+    return insert(hl, n);
+}
+
+static node_t *join(hashlife_t *hl, node_t *nw, node_t *ne, node_t *sw, node_t *se) {
+    if (!nw || !ne || !sw || !se) return NULL;
+    const uint32_t hash = hash_children(nw, ne, sw, se);
+    for (node_t *n = hl->buckets[hash & (hl->bucket_count - 1)]; n; n = n->next) {
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) return n;
+    }
+
+    node_t *n = alloc_node(hl);
+    if (!n) return NULL;
+    memset(n, 0, sizeof(*n));
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->population = add_sat(add_sat(nw->population, ne->population), add_sat(sw->population, se->population));
+    n->hash = hash;
+    n->level = (int8_t) (nw->level + 1);
+    n->step = -1;
+    return insert(hl, n);
+}
+
+static node_t *empty(hashlife_t *hl, const int level) {
+    if (!hl->empty[level]) {
+        if (level == LEAF_LEVEL) {
+            hl->empty[level] = leaf(hl, 0);
+        } else {
+            node_t *e = empty(hl, level - 1);
+            hl->empty[level] = join(hl, e, e, e, e);
+        }
+    }
+    return hl->empty[level];
+}
+
+// 16x16 helpers for the level 4 base case, row y lives in the low 16 bits of rows[y]
+
+static void unpack16(const node_t *n, uint64_t rows[16]) {
+    for (int y = 0; y < 8; y++) {
+        rows[y] = (n->nw->bits >> (8 * y) & 0xFF) | (n->ne->bits >> (8 * y) & 0xFF) << 8;
+        rows[y + 8] = (n->sw->bits >> (8 * y) & 0xFF) | (n->se->bits >> (8 * y) & 0xFF) << 8;
+    }
+}
+
+static uint64_t center16(const uint64_t rows[16]) {
+    uint64_t bits = 0;
+    for (int y = 0; y < 8; y++) {
+        bits |= (rows[y + 4] >> 4 & 0xFF) << (8 * y);
+    }
+    return bits;
+}
+
+static void step16(const hashlife_t *hl, uint64_t rows[16]) {
+    const uint64_t none = 0;
+    const unsigned birth = hl->birth, survive = hl->survive;
+    uint64_t next[16];
+    for (int y = 0; y < 16; y++) {
+        const uint64_t a = y > 0 ? rows[y - 1] : 0, b = y < 15 ? rows[y + 1] : 0;
+        LIFE_NEXT_RULE(uint64_t, next[y], birth, survive, a, none, none, rows[y], none, none, b, none, none);
+        next[y] &= 0xFFFF;
+    }
+    memcpy(rows, next, sizeof(next));
+}
+
+// The center half of a node, one level down
+static node_t *center(hashlife_t *hl, const node_t *n) {
+    if (n->level == LEAF_LEVEL + 1) {
+        uint64_t rows[16];
+        unpack16(n, rows);
+        return leaf(hl, center16(rows));
+    }
+    return join(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+// The node straddling the border between two horizontal neighbors
+static node_t *join_h(hashlife_t *hl, const node_t *w, const node_t *e) {
+    return join(hl, w->ne, e->nw, w->se, e->sw);
+}
+
+// The node straddling the border between two vertical neighbors
+static node_t *join_v(hashlife_t *hl, const node_t *n, const node_t *s) {
+    return join(hl, n->sw, n->se, s->nw, s->ne);
+}
+
+// The center half of n advanced by 2^j generations, j <= level - 2.
+//
+// Split n into nine overlapping half sized nodes. Advancing each of them
+// (or just taking their centers when j is small) gives nine quarter sized
+// nodes whose four overlapping 2x2 groups are again advanced by the
+// remaining generations to tile the result.
+static node_t *result(hashlife_t *hl, node_t *n, const int j) {
+    if (!n) return NULL;
+    if (n->result && n->step == j) return n->result;
+
+    node_t *r;
+    if (n->population == 0) {
+        r = empty(hl, n->level - 1);
+    } else if (n->level == LEAF_LEVEL + 1) {
+        uint64_t rows[16];
+        unpack16(n, rows);
+        for (int i = 0; i < 1 << j; i++) {
+            step16(hl, rows);
+        }
+        r = leaf(hl, center16(rows));
+    } else {
+        node_t *const q[9] = {
+            n->nw, join_h(hl, n->nw, n->ne), n->ne,
+            join_v(hl, n->nw, n->sw), center(hl, n), join_v(hl, n->ne, n->se),
+            n->sw, join_h(hl, n->sw, n->se), n->se,
+        };
+        const bool full = j == n->level - 2;
+        node_t *s[9];
+        for (int i = 0; i < 9; i++) {
+            if (!q[i]) return NULL;
+            s[i] = full ? result(hl, q[i], j - 1) : center(hl, q[i]);
+        }
+        const int rest = full ? j - 1 : j;
+        r = join(hl,
+                 result(hl, join(hl, s[0], s[1], s[3], s[4]), rest),
+                 result(hl, join(hl, s[1], s[2], s[4], s[5]), rest),
+                 result(hl, join(hl, s[3], s[4], s[6], s[7]), rest),
+                 result(hl, join(hl, s[4], s[5], s[7], s[8]), rest));
+    }
+    if (!r) return NULL;
+
+    n->result = r;
+    n->step = (int8_t) j;
+    return r;
+}
+
+// Wraps the root in a border of empty space, doubling its size. False if
+// out of memory
+static bool expand(hashlife_t *hl) {
+    node_t *r = hl->root, *e = empty(hl, r->level - 1);
+    node_t *root = join(hl,
+                        join(hl, e, e, e, r->nw),
+                        join(hl, e, e, r->ne, e),
+                        join(hl, e, r->sw, e, e),
+                        join(hl, r->se, e, e, e));
+    if (!root) return false;
+    hl->root = root;
+    hl->origin *= 2;
+    return true;
+}
+
+// Whether everything alive sits in the center half of the root
+static bool centered(hashlife_t *hl) {
+    const node_t *r = hl->root;
+    const node_t *e = empty(hl, r->level - 2);
+    return e && r->nw->nw == e && r->nw->ne == e && r->nw->sw == e
+        && r->ne->nw == e && r->ne->ne == e && r->ne->se == e
+        && r->sw->nw == e && r->sw->sw == e && r->sw->se == e
+        && r->se->ne == e && r->se->sw == e && r->se->se == e;
+}
+
+static void mark(node_t *n, const bool results) {
+    while (n && !n->mark) {
+        n->mark = 1;
+        if (n->level > LEAF_LEVEL) {
+            mark(n->nw, results);
+            mark(n->ne, results);
+            mark(n->sw, results);
+        }
+        if (results) mark(n->result, results);
+        n = n->level > LEAF_LEVEL ? n->se : NULL;
+    }
+}
+
+// Frees every node not reachable from the root or the empty cache
+static void collect(hashlife_t *hl, const bool keep_results) {
+    mark(hl->root, keep_results);
+    for (int i = 0; i < MAX_LEVEL; i++) {
+        mark(hl->empty[i], keep_results);
+    }
+
+    for (size_t i = 0; i < hl->bucket_count; i++) {
+        node_t **slot = &hl->buckets[i];
+        while (*slot) {
+            node_t *n = *slot;
+            if (n->mark) {
+                n->mark = 0;
+                // A kept node may memoize a node we are about to free
+                if (!keep_results) n->result = NULL;
+                slot = &n->next;
+            } else {
+                *slot = n->next;
+                n->next = hl->free_list;
+                hl->free_list = n;
+                hl->count--;
+            }
+        }
+    }
+}
+
+hashlife_t *hashlife_create(const size_t max_nodes) {
+    hashlife_t *hl = SDL_calloc(1, sizeof(*hl));
+    if (!hl) return NULL;
+    hl->max_nodes = max_nodes ? max_nodes : DEFAULT_MAX_NODES;
+    hl->birth = RULE_CONWAY.birth;
+    hl->survive = RULE_CONWAY.survive;
+    hl->bucket_count = 1 << 16;
+    hl->buckets = SDL_calloc(hl->bucket_count, sizeof(node_t *));
+    if (!hl->buckets) {
+        SDL_free(hl);
+        return NULL;
+    }
+    hashlife_clear(hl);
+    if (!hl->root) {
+        hashlife_destroy(hl);
+        return NULL;
+    }
+    return hl;
+}
+
+void hashlife_destroy(hashlife_t *hl) {
+    if (!hl) return;
+    while (hl->slabs) {
+        slab_t *next = hl->slabs->next;
+        SDL_free(hl->slabs);
+        hl->slabs = next;
+    }
+    SDL_free(hl->buckets);
+    SDL_free(hl);
+}
+
+void hashlife_clear(hashlife_t *hl) {
+    hl->root = empty(hl, MIN_ROOT_LEVEL);
+    hl->origin = (int64_t) 1 << (MIN_ROOT_LEVEL - 1);
+    hl->generation = 0;
+    collect(hl, false);
+}
+
+bool hashlife_set_rule(hashlife_t *hl, const rule_t *rule) {
+    if (rule->states > 2 || rule->radius) return false;
+    if (rule->birth == hl->birth && rule->survive == hl->survive) return true;
+    hl->birth = rule->birth;
+    hl->survive = rule->survive;
+    // Every memoized result was computed under the old rule
+    collect(hl, false);
+    return true;
+}
+
+static int get(const node_t *n, int64_t y, int64_t x) {
+    while (n->level > LEAF_LEVEL) {
+        if (n->population == 0) return 0;
+        const int64_t half = (int64_t) 1 << (n->level - 1);
+        if (y < half) n = x < half ? n->nw : n->ne;
+        else n = x < half ? n->sw : n->se;
+        if (y >= half) y -= half;
+        if (x >= half) x -= half;
+    }
+    return (int) (n->bits >> (8 * y + x)) & 1;
+}
+
+static node_t *set(hashlife_t *hl, node_t *n, const int64_t y, const int64_t x, const int alive) {
+    if (n->level == LEAF_LEVEL) {
+        const uint64_t bit = UINT64_C(1) << (8 * y + x);
+        return leaf(hl, alive ? n->bits | bit : n->bits & ~bit);
+    }
+    const int64_t half = (int64_t) 1 << (n->level - 1);
+    if (y < half) {
+        if (x < half) return join(hl, set(hl, n->nw, y, x, alive), n->ne, n->sw, n->se);
+        return join(hl, n->nw, set(hl, n->ne, y, x - half, alive), n->sw, n->se);
+    }
+    if (x < half) return join(hl, n->nw, n->ne, set(hl, n->sw, y - half, x, alive), n->se);
+    return join(hl, n->nw, n->ne, n->sw, set(hl, n->se, y - half, x - half, alive));
+}
+
+int hashlife_get(const hashlife_t *hl, const int64_t y, const int64_t x) {
+    if (y < -hl->origin || y >= hl->origin || x < -hl->origin || x >= hl->origin) return 0;
+    return get(hl->root, y + hl->origin, x + hl->origin);
+}
+
+bool hashlife_set(hashlife_t *hl, const int64_t y, const int64_t x, const int alive) {
+    while (y < -hl->origin || y >= hl->origin || x < -hl->origin || x >= hl->origin) {
+        if (!alive) return true;
+        if (!expand(hl)) return false;
+    }
+    node_t *root = set(hl, hl->root, y + hl->origin, x + hl->origin, alive);
+    if (!root) return false;
+    hl->root = root;
+    return true;
+}
+
+// Builds the node of `level` whose top left corner sits at grid cell (y, x)
+static node_t *build(hashlife_t *hl, const grid_t *g, const int level, const int64_t y, const int64_t x) {
+    const int64_t size = (int64_t) 1 << level;
+    if (y >= g->height || x >= g->width || y + size <= 0 || x + size <= 0) return empty(hl, level);
+
+    if (level == LEAF_LEVEL) {
+        uint64_t bits = 0;
+        for (int dy = 0; dy < 8; dy++) {
+            for (int dx = 0; dx < 8; dx++) {
+                const int64_t gy = y + dy, gx = x + dx;
+                if (gy >= 0 && gy < g->height && gx >= 0 && gx < g->width && grid_get(g, (int) gy, (int) gx)) {
+                    bits |= UINT64_C(1) << (8 * dy + dx);
+                }
+            }
+        }
+        return leaf(hl, bits);
+    }
+    const int64_t half = size / 2;
+    return join(hl,
+                build(hl, g, level - 1, y, x), build(hl, g, level - 1, y, x + half),
+                build(hl, g, level - 1, y + half, x), build(hl, g, level - 1, y + half, x + half));
+}
+
+bool hashlife_load_grid(hashlife_t *hl, const grid_t *g, const int64_t y, const int64_t x) {
+    hashlife_clear(hl);
+    while (y < -hl->origin || x < -hl->origin || y + g->height > hl->origin || x + g->width > hl->origin) {
+        if (!expand(hl)) return false;
+    }
+    node_t *root = build(hl, g, hl->root->level, -hl->origin - y, -hl->origin - x);
+    if (!root) {
+        hashlife_clear(hl);
+        return false;
+    }
+    hl->root = root;
+    return true;
+}
+
+static void store(const node_t *n, grid_t *g, const int64_t y, const int64_t x) {
+    const int64_t size = (int64_t) 1 << n->level;
+    if (n->population == 0 || y >= g->height || x >= g->width || y + size <= 0 || x + size <= 0) return;
+
+    if (n->level == LEAF_LEVEL) {
+        for (int dy = 0; dy < 8; dy++) {
+            for (int dx = 0; dx < 8; dx++) {
+                if (n->bits >> (8 * dy + dx) & 1) grid_set(g, (int) (y + dy), (int) (x + dx), 1);
+            }
+        }
+        return;
+    }
+    const int64_t half = size / 2;
+    store(n->nw, g, y, x);
+    store(n->ne, g, y, x + half);
+    store(n->sw, g, y + half, x);
+    store(n->se, g, y + half, x + half);
+}
+
+void hashlife_store_grid(const hashlife_t *hl, grid_t *g, const int64_t y, const int64_t x) {
+    grid_clear(g);
+    store(hl->root, g, -hl->origin - y, -hl->origin - x);
+}
+
+static bool step(hashlife_t *hl, const int k) {
+    // Get the pattern into the center quarter of a root big enough that
+    // nothing can travel out of the result in 2^k generations. Growing the
+    // root keeps the same cells, so a step that runs out of memory still
+    // leaves the universe as it was
+    while (hl->root->level < k + 3 || !centered(hl)) {
+        if (!expand(hl)) return false;
+    }
+    if (!expand(hl)) return false;
+    node_t *root = result(hl, hl->root, k);
+    if (!root) return false;
+    hl->root = root;
+    hl->origin /= 2;
+    hl->generation += (uint64_t) 1 << k;
+
+    // Shrink back so an emptied out universe doesn't keep a huge root
+    while (hl->root->level > MIN_ROOT_LEVEL && centered(hl)) {
+        if (!(root = center(hl, hl->root))) break;
+        hl->root = root;
+        hl->origin /= 2;
+    }
+    return true;
+}
+
+bool hashlife_step(hashlife_t *hl, int k) {
+    k = SDL_clamp(k, 0, MAX_STEP);
+    if (hl->count > hl->max_nodes) {
+        collect(hl, true);
+        if (hl->count > hl->max_nodes / 2) collect(hl, false);
+    }
+    if (step(hl, k)) return true;
+    // Whatever the failed step built is garbage now, and so are all the
+    // memoized results, which is a lot more room to try again in
+    collect(hl, false);
+    return step(hl, k);
+}
+
+uint64_t hashlife_generation(const hashlife_t *hl) {
+    return hl->generation;
+}
+
+uint64_t hashlife_population(const hashlife_t *hl) {
+    return hl->root->population;
+}
+
+size_t hashlife_nodes(const hashlife_t *hl) {
+    return hl->count;
+}
@@ -0,0 +1,56 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "life.h"
+
+// HashLife engine.
+//
+// The universe is an unbounded plane stored as a canonical quadtree: every
+// distinct 2^k x 2^k block exists exactly once in a hash-consing table, and
+// each node memoizes its RESULT, the center half of the block advanced by a
+// power of two generations. Repetitive patterns (periodic, sparse, gliders
+// drifting through empty space) then collapse into a handful of nodes and
+// can be advanced 2^k generations in about O(k) node visits.
+//
+// The node table is bounded by `max_nodes`: before every step the table is
+// garbage collected when it grew past the budget, first keeping memoized
+// results and, if that isn't enough, dropping them too. A single huge step
+// may still overshoot the budget until it finishes. If that runs out of
+// memory the step fails and leaves the universe as it was.
+
+typedef struct HashLife hashlife_t;
+
+// max_nodes of 0 picks a default of a few million nodes.
+hashlife_t *hashlife_create(size_t max_nodes);
+void hashlife_destroy(hashlife_t *hl);
+void hashlife_clear(hashlife_t *hl);
+
+// Switches the rule (Conway's by default), false for Generations rules
+// which a single bit per cell can't hold and Larger than Life ones, whose
+// neighbors reach past the 8x8 leaves.
+bool hashlife_set_rule(hashlife_t *hl, const rule_t *rule);
+
+int hashlife_get(const hashlife_t *hl, int64_t y, int64_t x);
+// False if out of memory, leaving the universe as it was.
+bool hashlife_set(hashlife_t *hl, int64_t y, int64_t x, int alive);
+
+// Replaces the universe with the grid placed with its top left cell at
+// (y, x), and copies the same window back out again. Cells outside the
+// window are dropped by the copy out. Loading fails if out of memory,
+// leaving an empty universe.
+bool hashlife_load_grid(hashlife_t *hl, const grid_t *g, int64_t y, int64_t x);
+void hashlife_store_grid(const hashlife_t *hl, grid_t *g, int64_t y, int64_t x);
+
+// Advances the universe by 2^k generations, k is clamped to [0, 48]. False
+// if out of memory even after collecting every node it could.
+bool hashlife_step(hashlife_t *hl, int k);
+
+uint64_t hashlife_generation(const hashlife_t *hl);
+// Saturates at UINT64_MAX.
+uint64_t hashlife_population(const hashlife_t *hl);
+size_t hashlife_nodes(const hashlife_t *hl);
+
+#endif
@@ -0,0 +1,300 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "history.h"
+
+// Tile: index, then per plane a mask of its non-zero rows and those rows
+#define TILE_MAX_WORDS(planes) (1 + (size_t) (planes) * (1 + LIFE_TILE_ROWS))
+
+typedef struct Entry {
+    uint64_t generation;    // after the entry
+    size_t delta, key;      // words of each
+    bool keyframe;          // key holds the state after the entry
+    uint64_t words[];       // the delta, then the state after it
+} entry_t;
+
+struct History {
+    grid_t shadow;          // the state the newest recorded entry left
+    int tile_cols, tile_rows;
+    uint64_t *scratch;      // the entry being recorded, grown as needed
+    size_t scratch_words;
+    // Of the entries, and of the shadow and scratch which count against
+    // the budget as well
+    size_t budget, bytes, fixed;
+    int keyframe_every, since_key;
+
+    // Entries oldest first in a ring, pos is the one the board is at,
+    // -1 for the state before the oldest
+    entry_t **ring;
+    size_t capacity, head, count;
+    long pos;
+    uint64_t base_generation; // before the oldest
+};
+
+static entry_t *entry_at(const history_t *h, const long i) {
+    return h->ring[(h->head + (size_t) i) % h->capacity];
+}
+
+static size_t entry_bytes(const entry_t *e) {
+    return sizeof(*e) + (e->delta + e->key) * sizeof(uint64_t);
+}
+
+static uint64_t generation_at(const history_t *h, const long i) {
+    return i < 0 ? h->base_generation : entry_at(h, i)->generation;
+}
+
+static void sync_shadow(history_t *h, const grid_t *g) {
+    for (int p = 0; p < g->planes; p++) {
+        for (int y = 0; y < g->height; y++) {
+            memcpy(grid_plane_row(&h->shadow, p, y), grid_plane_row(g, p, y), g->words * sizeof(uint64_t));
+        }
+    }
+}
+
+size_t history_min_budget(const grid_t *g) {
+    return (size_t) g->planes * g->plane_stride * sizeof(uint64_t);
+}
+
+history_t *history_create(const grid_t *g, const uint64_t generation, const size_t budget, const int keyframe_every) {
+    if (budget < history_min_budget(g)) {
+        SDL_SetError("A %d x %d board needs a history budget of at least %zu bytes", g->width, g->height, history_min_budget(g));
+        return NULL;
+    }
+    history_t *h = SDL_calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->tile_cols = g->words;
+    h->tile_rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    h->budget = budget;
+    h->keyframe_every = SDL_max(keyframe_every, 1);
+    h->pos = -1;
+    h->base_generation = generation;
+    h->fixed = history_min_budget(g);
+    if (!grid_create_planes(&h->shadow, g->width, g->height, g->planes)) {
+        history_destroy(h);
+        return NULL;
+    }
+    sync_shadow(h, g);
+    return h;
+}
+
+static void drop_newest(history_t *h) {
+    entry_t *e = entry_at(h, (long) h->count - 1);
+    h->bytes -= entry_bytes(e);
+    h->count--;
+    SDL_free(e);
+}
+
+static void drop_oldest(history_t *h) {
+    entry_t *e = entry_at(h, 0);
+    h->bytes -= entry_bytes(e);
+    h->base_generation = e->generation;
+    h->head = (h->head + 1) % h->capacity;
+    h->count--;
+    h->pos--;
+    SDL_free(e);
+}
+
+static void forget(history_t *h, const uint64_t generation) {
+    while (h->count) drop_newest(h);
+    h->head = 0;
+    h->pos = -1;
+    h->base_generation = generation;
+}
+
+void history_destroy(history_t *h) {
+    if (!h) return;
+    while (h->count) drop_newest(h);
+    grid_destroy(&h->shadow);
+    SDL_free(h->scratch);
+    SDL_free(h->ring);
+    SDL_free(h);
+}
+
+// Room for `words` more after the first `used` words of scratch, false if
+// out of memory
+static bool reserve(history_t *h, const size_t used, const size_t words) {
+    if (used + words <= h->scratch_words) return true;
+    const size_t capacity = SDL_max(2 * h->scratch_words, used + words);
+    uint64_t *scratch = SDL_realloc(h->scratch, capacity * sizeof(uint64_t));
+    if (!scratch) return false;
+    h->fixed += (capacity - h->scratch_words) * sizeof(uint64_t);
+    h->scratch = scratch;
+    h->scratch_words = capacity;
+    return true;
+}
+
+static void drop_scratch(history_t *h) {
+    h->fixed -= h->scratch_words * sizeof(uint64_t);
+    SDL_free(h->scratch);
+    h->scratch = NULL;
+    h->scratch_words = 0;
+}
+
+// Packs tile (ty, tx) of a ^ b (a alone if b is NULL), nothing if it's all
+// zero. Returns the words written
+static size_t pack_tile(const history_t *h, const grid_t *a, const grid_t *b, const int ty, const int tx, uint64_t *out) {
+    uint64_t *p = out + 1;
+    bool any = false;
+    out[0] = (uint64_t) ty * h->tile_cols + tx;
+    for (int pl = 0; pl < a->planes; pl++) {
+        uint64_t *mask = p++;
+        *mask = 0;
+        for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+            const int y = ty * LIFE_TILE_ROWS + i;
+            if (y >= a->height) break;
+            const uint64_t w = grid_plane_row(a, pl, y)[tx] ^ (b ? grid_plane_row(b, pl, y)[tx] : 0);
+            if (w) {
+                *mask |= UINT64_C(1) << i;
+                *p++ = w;
+            }
+        }
+        any |= *mask != 0;
+    }
+    return any ? (size_t) (p - out) : 0;
+}
+
+// XORs packed tiles into g and the shadow, flagging them in t
+static void apply(history_t *h, grid_t *g, tiles_t *t, const uint64_t *p, const size_t words) {
+    const uint64_t *end = p + words;
+    while (p < end) {
+        const size_t index = (size_t) *p++;
+        const int ty = (int) (index / h->tile_cols), tx = (int) (index % h->tile_cols);
+        for (int pl = 0; pl < g->planes; pl++) {
+            const uint64_t mask = *p++;
+            for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+                if (mask >> i & 1) {
+                    const int y = ty * LIFE_TILE_ROWS + i;
+                    grid_plane_row(g, pl, y)[tx] ^= *p;
+                    grid_plane_row(&h->shadow, pl, y)[tx] ^= *p++;
+                }
+            }
+        }
+        t->changed[index] = 1;
+    }
+}
+
+void history_record(history_t *h, const grid_t *g, const uint8_t *changed, const uint64_t generation) {
+    // Scratch only grows to the biggest entry so far, not the whole grid
+    const size_t tile_words = TILE_MAX_WORDS(g->planes);
+    size_t delta = 0;
+    for (int ty = 0; ty < h->tile_rows; ty++) {
+        for (int tx = 0; tx < h->tile_cols; tx++) {
+            if (!changed[ty * h->tile_cols + tx]) continue;
+            if (!reserve(h, delta, tile_words)) {
+                // The shadow hasn't moved on yet, but what changed can't be
+                // told apart from it anymore either
+                sync_shadow(h, g);
+                forget(h, generation);
+                return;
+            }
+            delta += pack_tile(h, g, &h->shadow, ty, tx, h->scratch + delta);
+        }
+    }
+    if (!delta && generation == generation_at(h, h->pos)) return;
+
+    // Recording after a rewind forgets what was undone
+    while ((long) h->count - 1 > h->pos) drop_newest(h);
+
+    // Bring the shadow up to date, then snapshot it if a keyframe is due
+    const uint64_t *p = h->scratch, *end = h->scratch + delta;
+    while (p < end) {
+        const size_t index = (size_t) *p++;
+        const int ty = (int) (index / h->tile_cols), tx = (int) (index % h->tile_cols);
+        for (int pl = 0; pl < g->planes; pl++) {
+            const uint64_t mask = *p++;
+            for (int i = 0; i < LIFE_TILE_ROWS; i++) {
+                if (mask >> i & 1) grid_plane_row(&h->shadow, pl, ty * LIFE_TILE_ROWS + i)[tx] ^= *p++;
+            }
+        }
+    }
+    size_t key = 0;
+    const bool keyframe = ++h->since_key >= h->keyframe_every;
+    if (keyframe) {
+        h->since_key = 0;
+        for (int ty = 0; ty < h->tile_rows; ty++) {
+            for (int tx = 0; tx < h->tile_cols; tx++) {
+                if (!reserve(h, delta + key, tile_words)) {
+                    forget(h, generation);
+                    return;
+                }
+                key += pack_tile(h, &h->shadow, NULL, ty, tx, h->scratch + delta + key);
+            }
+        }
+    }
+
+    // Out of memory the shadow has already moved on without the entry, so
+    // start over from here rather than leave a gap
+    entry_t *e = SDL_malloc(sizeof(*e) + (delta + key) * sizeof(uint64_t));
+    if (!e) {
+        forget(h, generation);
+        return;
+    }
+    if (h->count == h->capacity) {
+        const size_t capacity = h->capacity ? 2 * h->capacity : 64;
+        entry_t **ring = SDL_malloc(capacity * sizeof(*ring));
+        if (!ring) {
+            SDL_free(e);
+            forget(h, generation);
+            return;
+        }
+        for (size_t i = 0; i < h->count; i++) ring[i] = entry_at(h, (long) i);
+        SDL_free(h->ring);
+        h->ring = ring;
+        h->capacity = capacity;
+        h->head = 0;
+    }
+    e->generation = generation;
+    e->delta = delta;
+    e->key = key;
+    e->keyframe = keyframe;
+    memcpy(e->words, h->scratch, (delta + key) * sizeof(uint64_t));
+    h->ring[(h->head + h->count) % h->capacity] = e;
+    h->count++;
+    h->pos = (long) h->count - 1;
+    h->bytes += entry_bytes(e);
+
+    // Scratch is only kept around to save reallocating it, and the newest
+    // entry goes too if it alone doesn't fit, leaving nothing to rewind
+    if (h->bytes + h->fixed > h->budget) drop_scratch(h);
+    while (h->bytes + h->fixed > h->budget && h->count) drop_oldest(h);
+}
+
+bool history_seek(history_t *h, grid_t *g, tiles_t *t, const long offset, uint64_t *generation) {
+    const long target = SDL_clamp(h->pos + offset, -1, (long) h->count - 1);
+    if (target == h->pos) return false;
+
+    if (target > h->pos) {
+        for (long i = h->pos + 1; i <= target; i++) {
+            const entry_t *e = entry_at(h, i);
+            apply(h, g, t, e->words, e->delta);
+        }
+    } else {
+        // Undo everything in between, or start over from the nearest
+        // keyframe at or before the target, whichever touches less
+        size_t back = 0, forward = 0;
+        for (long i = target + 1; i <= h->pos; i++) back += entry_at(h, i)->delta;
+        long k = target;
+        while (k >= 0 && !entry_at(h, k)->keyframe) forward += entry_at(h, k--)->delta;
+        const size_t grid_words = (size_t) g->planes * g->height * g->words;
+        if (k >= 0 && grid_words + entry_at(h, k)->key + forward < back) {
+            const entry_t *e = entry_at(h, k);
+            grid_clear(g);
+            grid_clear(&h->shadow);
+            tiles_mark_all(t);
+            apply(h, g, t, e->words + e->delta, e->key);
+            for (long i = k + 1; i <= target; i++) apply(h, g, t, entry_at(h, i)->words, entry_at(h, i)->delta);
+        } else {
+            for (long i = h->pos; i > target; i--) apply(h, g, t, entry_at(h, i)->words, entry_at(h, i)->delta);
+        }
+    }
+    h->pos = target;
+    *generation = generation_at(h, target);
+    return true;
+}
+
+size_t history_bytes(const history_t *h) {
+    return h->bytes + h->fixed;
+}
+
+size_t history_entries(const history_t *h) {
+    return h->count;
+}
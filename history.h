@@ -0,0 +1,46 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "life.h"
+
+// Rewindable history of a board.
+//
+// Every recorded step or edit is kept as the XOR of the tiles it changed,
+// each stored as a mask of its non-zero rows followed by those rows, so a
+// delta costs about as much as the cells it flipped. XOR works both ways:
+// applying an entry again undoes it, which is how the board is scrubbed
+// backwards, and applying it once more redoes it.
+//
+// Every `keyframe_every` entries also carry a full snapshot so a far seek
+// can start from the nearest one instead of undoing everything in between,
+// whichever touches fewer bytes. The oldest entries are dropped once the
+// whole history outgrows `budget` bytes, which includes the copy of the
+// board it diffs against and the room it packs the newest entry in.
+
+typedef struct History history_t;
+
+// The least budget a history of g can have, its copy of the board.
+size_t history_min_budget(const grid_t *g);
+// Starts an empty history at the current state of g, NULL if out of memory
+// or the budget is below history_min_budget().
+history_t *history_create(const grid_t *g, uint64_t generation, size_t budget, int keyframe_every);
+void history_destroy(history_t *h);
+
+// Records how g differs from the last recorded state, only looking at the
+// tiles flagged in `changed` (laid out like tiles_t). Anything that was
+// undone is forgotten first, unless nothing changed, in which case nothing
+// is recorded.
+void history_record(history_t *h, const grid_t *g, const uint8_t *changed, uint64_t generation);
+
+// Moves g up to `offset` entries forward (positive) or back (negative),
+// flagging every tile it touches in t and setting *generation to the one
+// it arrived at. False if there was nowhere to go.
+bool history_seek(history_t *h, grid_t *g, tiles_t *t, long offset, uint64_t *generation);
+
+size_t history_bytes(const history_t *h);
+size_t history_entries(const history_t *h);
+
+#endif
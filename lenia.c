@@ -0,0 +1,262 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "lenia.h"
+#include "soup.h"
+
+static const struct {
+    const char *name, *params;
+} named[] = {
+    {"orbium", "R13,T10,M0.15,S0.015,B1"},
+};
+
+// Cells this low draw as nothing, a sample is 0 to 255
+#define SHOWING (0.5f / 255)
+
+// Decimal number from min to max
+static bool parse_float(const char **s, const float min, const float max, float *out) {
+    char *end;
+    const double v = SDL_strtod(*s, &end);
+    if (end == *s || v < min || v > max) return false;
+    *s = end;
+    *out = (float) v;
+    return true;
+}
+
+static bool parse_int(const char **s, const int min, const int max, int *out) {
+    if (**s < '0' || **s > '9') return false;
+    long n = 0;
+    for (; **s >= '0' && **s <= '9'; (*s)++) {
+        n = n * 10 + (**s - '0');
+        if (n > max) return false;
+    }
+    if (n < min) return false;
+    *out = (int) n;
+    return true;
+}
+
+bool lenia_parse(lenia_params_t *params, const char *str) {
+    for (size_t i = 0; i < SDL_arraysize(named); i++) {
+        if (SDL_strcasecmp(str, named[i].name) == 0) str = named[i].params;
+    }
+    lenia_params_t p = {.steps = 10, .peaks = 1, .beta = {1}};
+    bool seen[26] = {false};
+    for (const char *s = str;; s++) {
+        const int letter = SDL_toupper((unsigned char) *s);
+        if (letter < 'A' || letter > 'Z' || seen[letter - 'A']) return false;
+        seen[letter - 'A'] = true;
+        s++;
+        switch (letter) {
+            default: return false;
+            case 'R':
+                // At R1 the neighbors sit on the kernel's edge, where it's 0
+                if (!parse_int(&s, 2, 1024, &p.radius)) return false;
+                break;
+            case 'T':
+                if (!parse_int(&s, 1, 1000, &p.steps)) return false;
+                break;
+            case 'M':
+                if (!parse_float(&s, 0, 1, &p.mu)) return false;
+                break;
+            case 'S':
+                if (!parse_float(&s, 1e-3f, 1, &p.sigma)) return false;
+                break;
+            case 'B':
+                for (p.peaks = 0;; s++) {
+                    if (p.peaks == LENIA_MAX_PEAKS || !parse_float(&s, 0, 1, &p.beta[p.peaks++])) return false;
+                    if (*s != '/') break;
+                }
+                break;
+        }
+        if (*s == '\0') break;
+        if (*s != ',') return false;
+    }
+    if (!seen['R' - 'A'] || !seen['M' - 'A'] || !seen['S' - 'A']) return false;
+    *params = p;
+    return true;
+}
+
+void lenia_format(const lenia_params_t *params, char *buf, const size_t size) {
+    int n = SDL_snprintf(buf, size, "R%d,T%d,M%g,S%g,B%g", params->radius, params->steps, params->mu, params->sigma, params->beta[0]);
+    for (int i = 1; i < params->peaks && n >= 0 && (size_t) n < size; i++) {
+        n += SDL_snprintf(buf + n, size - (size_t) n, "/%g", params->beta[i]);
+    }
+}
+
+// The kernel at distance r / radius, before adding up to 1
+static float shell(const lenia_params_t *p, const double r) {
+    if (r >= 1) return 0;
+    const double b = r * p->peaks;
+    const int peak = (int) b;
+    const double x = b - peak;
+    if (x <= 0) return 0;
+    return (float) (p->beta[peak] * SDL_exp(4 - 1 / (x * (1 - x))));
+}
+
+// Lays the kernel out around cell (0, 0), wrapping round to the far sides,
+// and keeps its spectrum
+static bool make_kernel(lenia_t *l) {
+    const int r = l->params.radius;
+    if (2 * r + 1 > SDL_min(l->width, l->height)) {
+        SDL_SetError("A radius %d kernel doesn't fit a %d x %d board", r, l->width, l->height);
+        return false;
+    }
+    float *k = l->potential;
+    memset(k, 0, (size_t) l->width * l->height * sizeof(float));
+    double total = 0;
+    for (int dy = -r; dy <= r; dy++) {
+        for (int dx = -r; dx <= r; dx++) {
+            const float v = shell(&l->params, SDL_sqrt((double) (dx * dx + dy * dy)) / r);
+            k[(size_t) ((dy + l->height) % l->height) * l->width + (dx + l->width) % l->width] = v;
+            total += v;
+        }
+    }
+    if (total <= 0) {
+        SDL_SetError("The kernel is empty");
+        return false;
+    }
+    fft_forward(l->fft, k, &l->kernel);
+    // Folding in the inverse's scale saves a pass over the board every step
+    const float scale = (float) (1 / (total * l->width * l->height));
+    const size_t n = (size_t) l->height * fft_stride(l->fft);
+    for (size_t i = 0; i < n; i++) {
+        l->kernel.re[i] *= scale;
+        l->kernel.im[i] *= scale;
+    }
+    return true;
+}
+
+int lenia_side(const int n) {
+    int p = 2;
+    while (p < n && p < 1 << 30) p *= 2;
+    return p;
+}
+
+lenia_t *lenia_create(const lenia_params_t *params, const int width, const int height, pool_t *pool) {
+    lenia_t *l = SDL_calloc(1, sizeof(lenia_t));
+    if (!l) return NULL;
+    l->params = *params;
+    l->width = width;
+    l->height = height;
+    l->pool = pool;
+    for (int i = 0; i <= LENIA_GROWTH_STEPS; i++) {
+        const double d = (double) i / LENIA_GROWTH_STEPS - params->mu, sigma = params->sigma;
+        l->growth[i] = (float) ((2 * SDL_exp(-d * d / (2 * sigma * sigma)) - 1) / params->steps);
+    }
+    const size_t cells = (size_t) width * height;
+    l->cells = SDL_calloc(cells, sizeof(float));
+    l->potential = SDL_malloc(cells * sizeof(float));
+    l->row_mass = SDL_malloc((size_t) height * sizeof(float));
+    l->row_x0 = SDL_malloc((size_t) height * sizeof(int));
+    l->row_x1 = SDL_malloc((size_t) height * sizeof(int));
+    if (!l->cells || !l->potential || !l->row_mass || !l->row_x0 || !l->row_x1
+            || !(l->fft = fft_create(width, height, pool))
+            || !fft_spectrum_create(l->fft, &l->spectrum) || !fft_spectrum_create(l->fft, &l->kernel)
+            || !make_kernel(l)) {
+        lenia_destroy(l);
+        return NULL;
+    }
+    lenia_clear(l);
+    return l;
+}
+
+void lenia_destroy(lenia_t *l) {
+    if (!l) return;
+    if (l->fft) {
+        fft_spectrum_destroy(&l->spectrum);
+        fft_spectrum_destroy(&l->kernel);
+        fft_destroy(l->fft);
+    }
+    SDL_free(l->cells);
+    SDL_free(l->potential);
+    SDL_free(l->row_mass);
+    SDL_free(l->row_x0);
+    SDL_free(l->row_x1);
+    SDL_free(l);
+}
+
+void lenia_clear(lenia_t *l) {
+    memset(l->cells, 0, (size_t) l->width * l->height * sizeof(float));
+    lenia_refresh(l);
+}
+
+void lenia_soup(lenia_t *l, const uint64_t seed, const int percent, int y0, int y1, int x0, int x1) {
+    y0 = SDL_max(y0, 0);
+    y1 = SDL_min(y1, l->height);
+    x0 = SDL_max(x0, 0);
+    x1 = SDL_min(x1, l->width);
+    for (int y = y0; y < y1; y++) {
+        float *row = l->cells + (size_t) y * l->width;
+        for (int x = x0; x < x1; x++) {
+            // The low bits pick whether it's set, the high ones the value
+            const uint64_t h = soup_hash(seed, (uint64_t) y << 32 | (uint32_t) x);
+            row[x] = (int) ((uint32_t) h % 100) < percent ? (float) (h >> 40) / (float) (1 << 24) : 0;
+        }
+    }
+}
+
+// Sums up row y for the stats
+static void tally(lenia_t *l, const int y) {
+    const float *row = l->cells + (size_t) y * l->width;
+    float mass = 0;
+    int first = l->width, last = -1;
+    for (int x = 0; x < l->width; x++) {
+        mass += row[x];
+        if (row[x] < SHOWING) continue;
+        if (x < first) first = x;
+        last = x;
+    }
+    l->row_mass[y] = mass;
+    l->row_x0[y] = first;
+    l->row_x1[y] = last;
+}
+
+static void tally_rows(void *data, const int y0, const int y1) {
+    for (int y = y0; y < y1; y++) tally(data, y);
+}
+
+// Grows rows [y0, y1) by their potential, summing them up while they're
+// still in cache
+static void grow(void *data, const int y0, const int y1) {
+    lenia_t *l = data;
+    for (int y = y0; y < y1; y++) {
+        float *row = l->cells + (size_t) y * l->width;
+        const float *u = l->potential + (size_t) y * l->width;
+        for (int x = 0; x < l->width; x++) {
+            const float at = SDL_clamp(u[x], 0.0f, 1.0f) * LENIA_GROWTH_STEPS;
+            const int i = SDL_min((int) at, LENIA_GROWTH_STEPS - 1);
+            const float g = l->growth[i] + (l->growth[i + 1] - l->growth[i]) * (at - (float) i);
+            row[x] = SDL_clamp(row[x] + g, 0.0f, 1.0f);
+        }
+        tally(l, y);
+    }
+}
+
+// Adds up the rows' tallies into the stats
+static void sum_rows(lenia_t *l) {
+    double mass = 0;
+    life_stats_t s = {.x0 = l->width, .x1 = -1, .y0 = l->height, .y1 = -1};
+    for (int y = 0; y < l->height; y++) {
+        mass += l->row_mass[y];
+        if (l->row_x1[y] < 0) continue;
+        s.x0 = SDL_min(s.x0, l->row_x0[y]);
+        s.x1 = SDL_max(s.x1, l->row_x1[y]);
+        if (s.y1 < 0) s.y0 = y;
+        s.y1 = y;
+    }
+    if (s.x1 < 0) s.x0 = s.y0 = 0;
+    s.population = (uint64_t) (mass + 0.5);
+    l->stats = s;
+}
+
+void lenia_refresh(lenia_t *l) {
+    pool_run(l->pool, tally_rows, l, l->height);
+    sum_rows(l);
+}
+
+void lenia_step(lenia_t *l) {
+    fft_forward(l->fft, l->cells, &l->spectrum);
+    fft_multiply(l->fft, &l->spectrum, &l->kernel);
+    fft_inverse(l->fft, &l->spectrum, l->potential);
+    pool_run(l->pool, grow, l, l->height);
+    sum_rows(l);
+}
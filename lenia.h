@@ -0,0 +1,84 @@
+#ifndef LENIA_H
+#define LENIA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fft.h"
+#include "life.h"
+#include "pool.h"
+
+// Lenia, a continuous cellular automaton: cells hold a value from 0 to 1
+// instead of being alive or dead, and step by
+//
+//   A += dt * G(K * A), clipped to [0, 1]
+//
+// where K * A is each cell's neighborhood, a weighted sum out to `radius`
+// cells, dt = 1 / steps and G(u) = 2 e^(-(u - mu)^2 / 2 sigma^2) - 1 grows
+// cells whose neighborhood is close to mu and shrinks the rest. K is a set
+// of concentric rings, one per peak weighted by it, each a smooth bump
+// e^(4 - 1 / r(1 - r)) across its width, and adds up to 1.
+//
+// With radius 13 a neighborhood is already ~530 cells, so the sum goes
+// through the FFT instead: the board's spectrum times K's, which is worked
+// out once when the board is made, and back. Convolving that way wraps
+// around, so Lenia boards are tori with power of two sides.
+
+#define LENIA_MAX_PEAKS 4
+// Growth is looked up rather than exponentiated for every cell, interpolating
+// between this many steps of the potential from 0 to 1. That's within 1e-4
+// of G for a sigma down to 0.003
+#define LENIA_GROWTH_STEPS 16384
+
+typedef struct LeniaParams {
+    int radius;     // R, of the kernel in cells
+    int steps;      // T, per unit of time
+    float mu, sigma;
+    int peaks;
+    float beta[LENIA_MAX_PEAKS];    // ring weights, inside out
+} lenia_params_t;
+
+typedef struct Lenia {
+    lenia_params_t params;
+    int width, height;
+    float *cells;           // row by row
+    // Of the board the last step produced, population being the total of
+    // the cells rounded and the box holding the ones that show at all. No
+    // births or deaths, cells just fade in and out
+    life_stats_t stats;
+
+    pool_t *pool;
+    fft_t *fft;
+    spectrum_t spectrum, kernel;    // the kernel's scaled to undo the inverse's width * height
+    float *potential;               // K * A
+    float growth[LENIA_GROWTH_STEPS + 1];   // dt * G at every step
+    // Per row: the total of the cells and the first and last one showing
+    float *row_mass;
+    int *row_x0, *row_x1;
+} lenia_t;
+
+// Parses "R13,T10,M0.15,S0.015,B1" like the rules in rule.h, peaks going
+// B1/0.5/..., or a name like "orbium". False if it's neither.
+bool lenia_parse(lenia_params_t *params, const char *str);
+void lenia_format(const lenia_params_t *params, char *buf, size_t size);
+
+// The side a Lenia board needs to be at least n cells: the smallest power
+// of two that is, and 2.
+int lenia_side(int n);
+// An empty width x height board, NULL if the sides aren't powers of two,
+// the kernel doesn't fit or out of memory. Steps on every thread of pool.
+lenia_t *lenia_create(const lenia_params_t *params, int width, int height, pool_t *pool);
+void lenia_destroy(lenia_t *l);
+void lenia_clear(lenia_t *l);
+
+// Sets `percent` percent of cells [x0, x1) of rows [y0, y1) (clipped to the
+// board) to a random value and clears the rest. Like soup_fill() every
+// cell's value only depends on the seed and where it is.
+void lenia_soup(lenia_t *l, uint64_t seed, int percent, int y0, int y1, int x0, int x1);
+// Stepping keeps l->stats up to date, edits like the above don't: this
+// recounts them.
+void lenia_refresh(lenia_t *l);
+
+void lenia_step(lenia_t *l);
+
+#endif
@@ -0,0 +1,639 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "life.h"
+#include "ltl.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIFE_X86_SIMD 1
+#endif
+
+// Steps words [from, words) of row y from src into dst
+typedef void (*row_kernel_t)(const grid_t *src, grid_t *dst, int y, int from, int words);
+
+// Defines a row kernel stepping `sizeof(T) / 8` words per iteration for a
+// rule with the given birth / survive counts, which may be constants or
+// runtime values. Loads and stores go through memcpy so they compile to
+// unaligned moves, `tail` finishes words that don't fill a vector.
+#define LIFE_ROW_KERNEL(name, T, attr, birth, survive, tail)                \
+attr static void name(const grid_t *src, grid_t *dst, const int y, const int from, const int words) { \
+    const int lanes = (int) (sizeof(T) / sizeof(uint64_t));                 \
+    const unsigned birth_ = (birth), survive_ = (survive);                  \
+    const uint64_t *r = grid_row(src, y), *a = r - src->stride, *b = r + src->stride; \
+    uint64_t *out = grid_row(dst, y);                                       \
+    int i = from;                                                           \
+    for (; i + lanes <= words; i += lanes) {                                \
+        T va, vap, van, vr, vrp, vrn, vb, vbp, vbn, next;                   \
+        memcpy(&va, a + i, sizeof(T));                                      \
+        memcpy(&vap, a + i - 1, sizeof(T));                                 \
+        memcpy(&van, a + i + 1, sizeof(T));                                 \
+        memcpy(&vr, r + i, sizeof(T));                                      \
+        memcpy(&vrp, r + i - 1, sizeof(T));                                 \
+        memcpy(&vrn, r + i + 1, sizeof(T));                                 \
+        memcpy(&vb, b + i, sizeof(T));                                      \
+        memcpy(&vbp, b + i - 1, sizeof(T));                                 \
+        memcpy(&vbn, b + i + 1, sizeof(T));                                 \
+        LIFE_NEXT_RULE(T, next, birth_, survive_, va, vap, van, vr, vrp, vrn, vb, vbp, vbn); \
+        memcpy(out + i, &next, sizeof(T));                                  \
+    }                                                                       \
+    if (i < words) tail(src, dst, y, i, words);                             \
+}
+
+// Generations rules, on top of the life-like step: dying cells can't be
+// born, live cells that don't survive start dying, and the dying counter
+// held in planes 1.. counts up until it reaches the last state
+#define LIFE_GENERATIONS_KERNEL(name, T, attr, tail)                        \
+attr static void name(const grid_t *src, grid_t *dst, const int y, const int from, const int words) { \
+    const int lanes = (int) (sizeof(T) / sizeof(uint64_t));                 \
+    const unsigned birth_ = rule.birth, survive_ = rule.survive, last_ = (unsigned) rule.states - 2; \
+    const int bits_ = src->planes - 1;                                      \
+    const uint64_t *r = grid_row(src, y), *a = r - src->stride, *b = r + src->stride; \
+    uint64_t *out = grid_row(dst, y);                                       \
+    int i = from;                                                           \
+    for (; i + lanes <= words; i += lanes) {                                \
+        const T zero = {0};                                                 \
+        T va, vap, van, vr, vrp, vrn, vb, vbp, vbn, next, d[RULE_PLANE_BITS]; \
+        memcpy(&va, a + i, sizeof(T));                                      \
+        memcpy(&vap, a + i - 1, sizeof(T));                                 \
+        memcpy(&van, a + i + 1, sizeof(T));                                 \
+        memcpy(&vr, r + i, sizeof(T));                                      \
+        memcpy(&vrp, r + i - 1, sizeof(T));                                 \
+        memcpy(&vrn, r + i + 1, sizeof(T));                                 \
+        memcpy(&vb, b + i, sizeof(T));                                      \
+        memcpy(&vbp, b + i - 1, sizeof(T));                                 \
+        memcpy(&vbn, b + i + 1, sizeof(T));                                 \
+        LIFE_NEXT_RULE(T, next, birth_, survive_, va, vap, van, vr, vrp, vrn, vb, vbp, vbn); \
+        T dying = zero, last = ~zero;                                       \
+        for (int p = 0; p < bits_; p++) {                                   \
+            memcpy(&d[p], grid_plane_row(src, p + 1, y) + i, sizeof(T));    \
+            dying |= d[p];                                                  \
+            last &= last_ >> p & 1 ? d[p] : ~d[p];                          \
+        }                                                                   \
+        next &= ~dying;                                                     \
+        T carry = dying;                                                    \
+        for (int p = 0; p < bits_; p++) {                                   \
+            const T sum = d[p] ^ carry;                                     \
+            carry &= d[p];                                                  \
+            d[p] = sum & ~(dying & last);                                   \
+        }                                                                   \
+        if (bits_) d[0] |= vr & ~next;                                      \
+        memcpy(out + i, &next, sizeof(T));                                  \
+        for (int p = 0; p < bits_; p++) {                                   \
+            memcpy(grid_plane_row(dst, p + 1, y) + i, &d[p], sizeof(T));    \
+        }                                                                   \
+    }                                                                       \
+    if (i < words) tail(src, dst, y, i, words);                             \
+}
+
+// Most dying counter planes a rule can need, see rule_planes()
+#define RULE_PLANE_BITS 8
+
+static rule_t rule;
+static topology_t topology = TOPOLOGY_PLANE;
+static const char *const topology_names[TOPOLOGIES] = {"plane", "torus", "klein", "cross"};
+
+// Rules with kernels of their own, by birth and survive counts
+#define LIFE_RULES(X)                                     \
+    X(conway, 0x008, 0x00C)   /* B3/S23 */                \
+    X(highlife, 0x048, 0x00C) /* B36/S23 */               \
+    X(daynight, 0x1C8, 0x1D8) /* B3678/S34678 */          \
+    X(seeds, 0x004, 0x000)    /* B2/S */                  \
+    X(lwod, 0x008, 0x1FF)     /* B3/S012345678 */         \
+    X(maze, 0x008, 0x03E)     /* B3/S12345 */
+
+#ifdef LIFE_X86_SIMD
+typedef uint64_t v2u64 __attribute__((vector_size(16)));
+typedef uint64_t v4u64 __attribute__((vector_size(32)));
+
+#define LIFE_RULE_KERNELS(name, birth, survive)                             \
+    LIFE_ROW_KERNEL(name##_scalar, uint64_t, , birth, survive, name##_scalar) \
+    LIFE_ROW_KERNEL(name##_sse2, v2u64, __attribute__((target("sse2"))), birth, survive, name##_scalar) \
+    LIFE_ROW_KERNEL(name##_avx2, v4u64, __attribute__((target("avx2"))), birth, survive, name##_scalar)
+#define LIFE_RULE_ENTRY(name, birth, survive) {#name, {name##_scalar, name##_sse2, name##_avx2}},
+
+LIFE_GENERATIONS_KERNEL(generations_scalar, uint64_t, , generations_scalar)
+LIFE_GENERATIONS_KERNEL(generations_sse2, v2u64, __attribute__((target("sse2"))), generations_scalar)
+LIFE_GENERATIONS_KERNEL(generations_avx2, v4u64, __attribute__((target("avx2"))), generations_scalar)
+#else
+#define LIFE_RULE_KERNELS(name, birth, survive)                             \
+    LIFE_ROW_KERNEL(name##_scalar, uint64_t, , birth, survive, name##_scalar)
+#define LIFE_RULE_ENTRY(name, birth, survive) {#name, {name##_scalar, name##_scalar, name##_scalar}},
+
+LIFE_GENERATIONS_KERNEL(generations_scalar, uint64_t, , generations_scalar)
+#define generations_sse2 generations_scalar
+#define generations_avx2 generations_scalar
+#endif
+
+LIFE_RULES(LIFE_RULE_KERNELS)
+LIFE_RULE_KERNELS(generic, rule.birth, rule.survive)
+
+enum { ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISAS };
+
+typedef struct Kernel {
+    const char *name;
+    row_kernel_t isa[ISAS];
+} kernel_t;
+
+#define LIFE_RULE_COUNTS(name, birth, survive) {birth, survive},
+static const uint16_t counts[][2] = {LIFE_RULES(LIFE_RULE_COUNTS)};
+
+static const kernel_t kernels[] = {
+    LIFE_RULES(LIFE_RULE_ENTRY)
+    LIFE_RULE_ENTRY(generic, , )
+    {"generations", {generations_scalar, generations_sse2, generations_avx2}},
+    {"larger than life", {NULL, NULL, NULL}},   // see ltl.c
+};
+#define GENERIC (SDL_arraysize(counts))
+#define GENERATIONS (GENERIC + 1)
+#define LARGER (GENERIC + 2)
+
+static const char *const isa_names[ISAS] = {"scalar", "sse2", "avx2"};
+static int isa = ISA_SCALAR;
+static const kernel_t *kernel = &kernels[0];
+static row_kernel_t row_kernel = conway_scalar;
+
+// Longest run of tiles life_step_tiles() steps in one go
+#define TILE_RUN 64
+
+// Recounts tile (ty, tx) after it changed stepping from src into dst, and
+// adds its births and deaths
+#define LIFE_TILE_STATS(name, attr)                                         \
+attr static void name(const grid_t *src, const grid_t *dst, tiles_t *t, const int ty, const int tx, uint64_t *births, uint64_t *deaths) { \
+    const int y0 = ty * LIFE_TILE_ROWS, y1 = SDL_min(y0 + LIFE_TILE_ROWS, src->height); \
+    /* A wrapped src may have a live bit past the last cell */              \
+    const uint64_t keep = tx == src->words - 1 && src->width % 64 ? (UINT64_C(1) << (src->width % 64)) - 1 : ~UINT64_C(0); \
+    uint64_t cols = 0, rows = 0;                                            \
+    uint32_t born = 0, died = 0;                                            \
+    for (int y = y0; y < y1; y++) {                                         \
+        const uint64_t was = grid_row(src, y)[tx] & keep, now = grid_row(dst, y)[tx]; \
+        cols |= now;                                                        \
+        rows |= (uint64_t) (now != 0) << (y - y0);                          \
+        born += (uint32_t) life_popcount(now & ~was);                       \
+        died += (uint32_t) life_popcount(was & ~now);                       \
+    }                                                                       \
+    const size_t i = (size_t) ty * t->cols + tx;                            \
+    t->tile_pop[i] += born - died;                                          \
+    t->tile_cols[i] = cols;                                                 \
+    t->tile_rows[i] = rows;                                                 \
+    *births += born;                                                        \
+    *deaths += died;                                                        \
+}
+
+typedef void (*tile_stats_t)(const grid_t *src, const grid_t *dst, tiles_t *t, int ty, int tx, uint64_t *births, uint64_t *deaths);
+
+LIFE_TILE_STATS(tile_stats_scalar, )
+#ifdef LIFE_X86_SIMD
+// Without the instruction every popcount is a library call
+LIFE_TILE_STATS(tile_stats_popcnt, __attribute__((target("popcnt"))))
+#endif
+static tile_stats_t tile_stats = tile_stats_scalar;
+
+void life_init(void) {
+    isa = ISA_SCALAR;
+#ifdef LIFE_X86_SIMD
+    if (SDL_HasAVX2()) isa = ISA_AVX2;
+    else if (SDL_HasSSE2()) isa = ISA_SSE2;
+    if (__builtin_cpu_supports("popcnt")) tile_stats = tile_stats_popcnt;
+#endif
+    const rule_t conway = RULE_CONWAY;
+    life_set_rule(&conway);
+}
+
+const char *life_kernel_name(void) {
+    return isa_names[isa];
+}
+
+void life_set_rule(const rule_t *r) {
+    rule = *r;
+    size_t k = rule.radius ? LARGER : rule.states > 2 ? GENERATIONS : GENERIC;
+    for (size_t i = 0; i < SDL_arraysize(counts) && k == GENERIC; i++) {
+        if (counts[i][0] == rule.birth && counts[i][1] == rule.survive) k = i;
+    }
+    kernel = &kernels[k];
+    row_kernel = kernel->isa[isa];
+}
+
+const char *life_rule_kernel_name(void) {
+    return kernel->name;
+}
+
+void life_set_topology(const topology_t t) {
+    topology = t;
+}
+
+topology_t life_topology(void) {
+    return topology;
+}
+
+const char *topology_name(const topology_t t) {
+    return t >= 0 && t < TOPOLOGIES ? topology_names[t] : "unknown";
+}
+
+bool topology_parse(topology_t *t, const char *str) {
+    for (int i = 0; i < TOPOLOGIES; i++) {
+        if (SDL_strcasecmp(str, topology_names[i]) == 0) {
+            *t = (topology_t) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool grid_create(grid_t *g, const int width, const int height) {
+    return grid_create_planes(g, width, height, 1);
+}
+
+bool grid_create_planes(grid_t *g, const int width, const int height, const int planes) {
+    memset(g, 0, sizeof(*g));
+    if (width <= 0 || height <= 0 || planes < 1 || planes > RULE_PLANE_BITS + 1) return false;
+
+    g->width = width;
+    g->height = height;
+    g->words = LIFE_WORDS(width);
+    // Round up so every row starts on a cache line and at least one padding
+    // word follows the cells
+    g->stride = (g->words + LIFE_LINE_WORDS) / LIFE_LINE_WORDS * LIFE_LINE_WORDS;
+    g->planes = planes;
+    g->plane_stride = (height + 2) * g->stride;
+
+    // One line in front for the left halo word of the top halo row, the
+    // halo rows themselves and slack to align the lot
+    const size_t words = (size_t) planes * (size_t) g->plane_stride + 2 * LIFE_LINE_WORDS;
+    g->mem = SDL_calloc(words, sizeof(uint64_t));
+    if (!g->mem) return false;
+
+    const uintptr_t line = LIFE_LINE_WORDS * sizeof(uint64_t);
+    uint64_t *base = (uint64_t *) (((uintptr_t) g->mem + line - 1) & ~(line - 1));
+    g->cells = base + LIFE_LINE_WORDS + g->stride;
+    return true;
+}
+
+void grid_destroy(grid_t *g) {
+    SDL_free(g->mem);
+    memset(g, 0, sizeof(*g));
+}
+
+void grid_clear(grid_t *g) {
+    for (int p = 0; p < g->planes; p++) {
+        for (int y = 0; y < g->height; y++) {
+            memset(grid_plane_row(g, p, y), 0, g->words * sizeof(uint64_t));
+        }
+    }
+}
+
+static uint64_t reverse_bits(uint64_t w) {
+    w = (w >> 1 & UINT64_C(0x5555555555555555)) | (w & UINT64_C(0x5555555555555555)) << 1;
+    w = (w >> 2 & UINT64_C(0x3333333333333333)) | (w & UINT64_C(0x3333333333333333)) << 2;
+    w = (w >> 4 & UINT64_C(0x0F0F0F0F0F0F0F0F)) | (w & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4;
+    w = (w >> 8 & UINT64_C(0x00FF00FF00FF00FF)) | (w & UINT64_C(0x00FF00FF00FF00FF)) << 8;
+    w = (w >> 16 & UINT64_C(0x0000FFFF0000FFFF)) | (w & UINT64_C(0x0000FFFF0000FFFF)) << 16;
+    return w >> 32 | w << 32;
+}
+
+// The cells of row `from` back to front into row `to`. Reversed word by
+// word the row comes out `pad` cells too far right, the zeros that filled
+// up its last word
+static void mirror_row(const grid_t *g, const uint64_t *from, uint64_t *to) {
+    const int words = g->words, pad = words * 64 - g->width;
+    for (int i = 0; i < words; i++) {
+        const uint64_t lo = reverse_bits(from[words - 1 - i]);
+        const uint64_t hi = i + 1 < words ? reverse_bits(from[words - 2 - i]) : 0;
+        to[i] = pad ? lo >> pad | hi << (64 - pad) : lo;
+    }
+}
+
+void grid_wrap(grid_t *g) {
+    if (topology == TOPOLOGY_PLANE) return;
+    const int h = g->height, w = g->width, last = (w - 1) / 64;
+    const size_t bytes = (size_t) g->words * sizeof(uint64_t);
+    // The halo rows first, then the columns of every row including them,
+    // which gets the corners too
+    if (topology == TOPOLOGY_TORUS) {
+        memcpy(grid_row(g, -1), grid_row(g, h - 1), bytes);
+        memcpy(grid_row(g, h), grid_row(g, 0), bytes);
+    } else {
+        mirror_row(g, grid_row(g, h - 1), grid_row(g, -1));
+        mirror_row(g, grid_row(g, 0), grid_row(g, h));
+    }
+    const bool mirror = topology == TOPOLOGY_CROSS;
+    for (int y = -1; y <= h; y++) {
+        const uint64_t *from = grid_row(g, mirror ? h - 1 - y : y);
+        uint64_t *row = grid_row(g, y);
+        const uint64_t west = from[last] >> ((w - 1) % 64) & 1, east = from[0] & 1;
+        row[-1] = (row[-1] & ~(UINT64_C(1) << 63)) | west << 63;
+        row[w / 64] = (row[w / 64] & ~(UINT64_C(1) << (w % 64))) | east << (w % 64);
+    }
+}
+
+void grid_unwrap(grid_t *g) {
+    if (topology == TOPOLOGY_PLANE) return;
+    const int h = g->height, w = g->width;
+    for (int y = -1; y <= h; y++) {
+        uint64_t *row = grid_row(g, y);
+        row[-1] &= ~(UINT64_C(1) << 63);
+        row[w / 64] &= ~(UINT64_C(1) << (w % 64));
+    }
+    memset(grid_row(g, -1), 0, (size_t) g->words * sizeof(uint64_t));
+    memset(grid_row(g, h), 0, (size_t) g->words * sizeof(uint64_t));
+}
+
+// Every word mixed with its position on its own, so they can be summed up
+// in any order
+static uint64_t tile_hash(const grid_t *g, const int ty, const int tx) {
+    const int y0 = ty * LIFE_TILE_ROWS, y1 = SDL_min(y0 + LIFE_TILE_ROWS, g->height);
+    uint64_t hash = 0;
+    for (int p = 0; p < g->planes; p++) {
+        for (int y = y0; y < y1; y++) {
+            const uint64_t *w = grid_plane_row(g, p, y) + tx;
+            uint64_t z = *w ^ (uint64_t) (w - g->cells) * UINT64_C(0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+            z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+            hash += z ^ (z >> 31);
+        }
+    }
+    return hash;
+}
+
+uint64_t grid_hash(const grid_t *g) {
+    uint64_t hash = 0;
+    for (int ty = 0; ty < (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS; ty++) {
+        for (int tx = 0; tx < g->words; tx++) {
+            hash ^= tile_hash(g, ty, tx);
+        }
+    }
+    return hash;
+}
+
+// Grows s's bounding box to take in [x0, x1] x [y0, y1]
+static void stats_box(life_stats_t *s, const int x0, const int y0, const int x1, const int y1) {
+    if (s->x1 < s->x0) {
+        s->x0 = x0;
+        s->y0 = y0;
+        s->x1 = x1;
+        s->y1 = y1;
+        return;
+    }
+    s->x0 = SDL_min(s->x0, x0);
+    s->y0 = SDL_min(s->y0, y0);
+    s->x1 = SDL_max(s->x1, x1);
+    s->y1 = SDL_max(s->y1, y1);
+}
+
+// Counts the live cells of tile (ty, tx) of g from scratch
+static void count_tile(tiles_t *t, const grid_t *g, const int ty, const int tx) {
+    const size_t i = (size_t) ty * t->cols + tx;
+    const int y0 = ty * LIFE_TILE_ROWS, y1 = SDL_min(y0 + LIFE_TILE_ROWS, g->height);
+    t->tile_pop[i] = 0;
+    t->tile_cols[i] = t->tile_rows[i] = 0;
+    for (int y = y0; y < y1; y++) {
+        const uint64_t w = grid_row(g, y)[tx];
+        t->tile_pop[i] += (uint32_t) life_popcount(w);
+        t->tile_cols[i] |= w;
+        if (w) t->tile_rows[i] |= UINT64_C(1) << (y - y0);
+    }
+}
+
+// Sums up the population and bounding box of a tile row from its tiles
+static void roll_up_row(tiles_t *t, const int ty) {
+    life_stats_t *s = &t->row_stats[ty];
+    s->population = 0;
+    s->x0 = s->y0 = 0;
+    s->x1 = s->y1 = -1;
+    for (int tx = 0; tx < t->cols; tx++) {
+        const size_t i = (size_t) ty * t->cols + tx;
+        if (!t->tile_pop[i]) continue;
+        s->population += t->tile_pop[i];
+        stats_box(s, tx * 64 + life_lowest_bit(t->tile_cols[i]), ty * LIFE_TILE_ROWS + life_lowest_bit(t->tile_rows[i]),
+                  tx * 64 + life_highest_bit(t->tile_cols[i]), ty * LIFE_TILE_ROWS + life_highest_bit(t->tile_rows[i]));
+    }
+}
+
+// And the whole board from its tile rows
+static void roll_up(tiles_t *t) {
+    life_stats_t *s = &t->stats;
+    s->population = s->births = s->deaths = 0;
+    s->x0 = s->y0 = 0;
+    s->x1 = s->y1 = -1;
+    for (int ty = 0; ty < t->rows; ty++) {
+        const life_stats_t *r = &t->row_stats[ty];
+        s->population += r->population;
+        s->births += r->births;
+        s->deaths += r->deaths;
+        if (r->population) stats_box(s, r->x0, r->y0, r->x1, r->y1);
+    }
+}
+
+bool tiles_create(tiles_t *t, const grid_t *g) {
+    t->cols = g->words;
+    t->rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    const size_t tiles = (size_t) t->cols * t->rows;
+    t->changed = SDL_malloc(tiles);
+    t->next = SDL_malloc(tiles);
+    t->row_hash = SDL_calloc((size_t) t->rows, sizeof(uint64_t));
+    t->tile_hash = SDL_malloc(tiles * sizeof(uint64_t));
+    t->tile_pop = SDL_malloc(tiles * sizeof(uint32_t));
+    t->tile_cols = SDL_malloc(tiles * sizeof(uint64_t));
+    t->tile_rows = SDL_malloc(tiles * sizeof(uint64_t));
+    t->row_stats = SDL_calloc((size_t) t->rows, sizeof(life_stats_t));
+    t->tracking = 0;
+    t->hash = 0;
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->stats.x1 = t->stats.y1 = -1;
+    if (!t->changed || !t->next || !t->row_hash || !t->tile_hash
+            || !t->tile_pop || !t->tile_cols || !t->tile_rows || !t->row_stats) {
+        tiles_destroy(t);
+        return false;
+    }
+    tiles_mark_all(t);
+    return true;
+}
+
+void tiles_destroy(tiles_t *t) {
+    SDL_free(t->changed);
+    SDL_free(t->next);
+    SDL_free(t->row_hash);
+    SDL_free(t->tile_hash);
+    SDL_free(t->tile_pop);
+    SDL_free(t->tile_cols);
+    SDL_free(t->tile_rows);
+    SDL_free(t->row_stats);
+    memset(t, 0, sizeof(*t));
+}
+
+void tiles_mark_all(tiles_t *t) {
+    memset(t->changed, 1, (size_t) t->cols * t->rows);
+}
+
+void tiles_swap(tiles_t *t) {
+    uint8_t *tmp = t->changed;
+    t->changed = t->next;
+    t->next = tmp;
+    for (int ty = 0; ty < t->rows; ty++) {
+        t->hash ^= t->row_hash[ty];
+        t->row_hash[ty] = 0;
+    }
+    if (t->tracking & TILES_STATS) roll_up(t);
+}
+
+void tiles_track(tiles_t *t, const grid_t *g, const int what) {
+    if (what & TILES_HASH) {
+        t->hash = 0;
+        memset(t->row_hash, 0, (size_t) t->rows * sizeof(uint64_t));
+    }
+    for (int ty = 0; ty < t->rows; ty++) {
+        for (int tx = 0; tx < t->cols; tx++) {
+            const size_t i = (size_t) ty * t->cols + tx;
+            if (what & TILES_STATS) count_tile(t, g, ty, tx);
+            if (what & TILES_HASH) {
+                t->tile_hash[i] = tile_hash(g, ty, tx);
+                t->hash ^= t->tile_hash[i];
+            }
+        }
+        if (what & TILES_STATS) roll_up_row(t, ty);
+    }
+    t->tracking |= what;
+    if (what & TILES_STATS) roll_up(t);
+}
+
+void tiles_refresh(tiles_t *t, const grid_t *g) {
+    if (!t->tracking) return;
+    for (int ty = 0; ty < t->rows; ty++) {
+        bool any = false;
+        for (int tx = 0; tx < t->cols; tx++) {
+            const size_t i = (size_t) ty * t->cols + tx;
+            if (!t->changed[i]) continue;
+            any = true;
+            if (t->tracking & TILES_STATS) count_tile(t, g, ty, tx);
+            if (t->tracking & TILES_HASH) {
+                const uint64_t now = tile_hash(g, ty, tx);
+                t->hash ^= t->tile_hash[i] ^ now;
+                t->tile_hash[i] = now;
+            }
+        }
+        if (any && t->tracking & TILES_STATS) roll_up_row(t, ty);
+    }
+    if (t->tracking & TILES_STATS) roll_up(t);
+}
+
+// Whether any tile along the edge of the board changed
+static bool edge_changed(const tiles_t *t) {
+    const uint8_t *top = t->changed, *bottom = t->changed + (size_t) (t->rows - 1) * t->cols;
+    for (int tx = 0; tx < t->cols; tx++) {
+        if (top[tx] || bottom[tx]) return true;
+    }
+    for (int ty = 0; ty < t->rows; ty++) {
+        if (t->changed[(size_t) ty * t->cols] || t->changed[(size_t) ty * t->cols + t->cols - 1]) return true;
+    }
+    return false;
+}
+
+// Whether the tile or any of its eight neighbors changed
+static bool tile_active(const tiles_t *t, const int ty, const int tx) {
+    const int x0 = SDL_max(tx - 1, 0), x1 = SDL_min(tx + 1, t->cols - 1);
+    for (int y = SDL_max(ty - 1, 0); y <= SDL_min(ty + 1, t->rows - 1); y++) {
+        const uint8_t *row = t->changed + (size_t) y * t->cols;
+        for (int x = x0; x <= x1; x++) {
+            if (row[x]) return true;
+        }
+    }
+    return false;
+}
+
+// The kernel happily births cells past the right edge, clear them. With
+// the edges joined a live bit past the edge of src starts dying there too
+static inline void clip_row(grid_t *dst, const int y, const uint64_t tail) {
+    const int planes = topology == TOPOLOGY_PLANE ? 1 : dst->planes;
+    for (int p = 0; p < planes; p++) grid_plane_row(dst, p, y)[dst->words - 1] &= tail;
+}
+
+// Larger than Life counts run down a block of rows, the kernels go a row
+// at a time
+static void step_block(const grid_t *src, grid_t *dst, const int y0, const int y1, const int w0, const int w1) {
+    if (rule.radius) {
+        ltl_step(&rule, src, dst, y0, y1, w0, w1);
+        return;
+    }
+    for (int y = y0; y < y1; y++) row_kernel(src, dst, y, w0, w1);
+}
+
+void life_step_rows(const grid_t *src, grid_t *dst, const int y0, const int y1) {
+    const uint64_t tail = src->width % 64 ? (UINT64_C(1) << (src->width % 64)) - 1 : ~UINT64_C(0);
+
+    step_block(src, dst, y0, y1, 0, src->words);
+    for (int y = y0; y < y1; y++) clip_row(dst, y, tail);
+}
+
+void life_step_words(const grid_t *src, grid_t *dst, const int y0, const int y1, const int w0, const int w1) {
+    const uint64_t tail = src->width % 64 ? (UINT64_C(1) << (src->width % 64)) - 1 : ~UINT64_C(0);
+
+    step_block(src, dst, y0, y1, w0, w1);
+    if (w1 != src->words) return;
+    for (int y = y0; y < y1; y++) clip_row(dst, y, tail);
+}
+
+void life_step_tiles(const grid_t *src, grid_t *dst, tiles_t *t, const int ty0, const int ty1) {
+    const int words = src->words;
+    const uint64_t tail = src->width % 64 ? (UINT64_C(1) << (src->width % 64)) - 1 : ~UINT64_C(0);
+    // Across a joined edge a tile's neighbors are somewhere along the other
+    // side, or mirrored. Rather than working out which, a change anywhere on
+    // the edge wakes all of it
+    const bool edge = topology != TOPOLOGY_PLANE && edge_changed(t);
+
+    for (int ty = ty0; ty < ty1; ty++) {
+        const int y0 = ty * LIFE_TILE_ROWS, y1 = SDL_min(y0 + LIFE_TILE_ROWS, src->height);
+        uint8_t *next = t->next + (size_t) ty * t->cols;
+        memset(next, 0, t->cols);
+        uint64_t hash = 0, births = 0, deaths = 0;
+        bool changed = false;
+
+        // Step runs of neighboring active tiles together so the vector
+        // kernels get rows as wide as possible. Runs are capped so the
+        // per tile change masks fit in a local array the compiler can keep
+        // apart from the grids
+        const bool edge_row = edge && (ty == 0 || ty == t->rows - 1);
+        int tx = 0;
+        while (tx < t->cols) {
+            if (!edge_row && !(edge && tx == 0) && !tile_active(t, ty, tx)) {
+                tx++;
+                continue;
+            }
+            int end = tx + 1;
+            while (end < t->cols && end - tx < TILE_RUN
+                   && (edge_row || (edge && end == t->cols - 1) || tile_active(t, ty, end))) end++;
+
+            uint64_t diff[TILE_RUN] = {0};
+            if (rule.radius) ltl_step(&rule, src, dst, y0, y1, tx, end);
+            for (int y = y0; y < y1; y++) {
+                if (!rule.radius) row_kernel(src, dst, y, tx, end);
+                if (end == words) clip_row(dst, y, tail);
+                // Dying cells change every step too
+                for (int p = 0; p < src->planes; p++) {
+                    const uint64_t *r = grid_plane_row(src, p, y);
+                    const uint64_t *out = grid_plane_row(dst, p, y);
+                    for (int i = tx; i < end; i++) {
+                        diff[i - tx] |= out[i] ^ r[i];
+                    }
+                }
+            }
+            // Not the bit a wrapped src may have past the last cell
+            if (end == words) diff[end - 1 - tx] &= tail;
+            // A tile at a time while the run's rows are still in cache
+            for (int i = tx; i < end; i++) {
+                next[i] = diff[i - tx] != 0;
+                if (!next[i]) continue;
+                changed = true;
+                if (t->tracking & TILES_STATS) tile_stats(src, dst, t, ty, i, &births, &deaths);
+                if (t->tracking & TILES_HASH) {
+                    uint64_t *old = t->tile_hash + (size_t) ty * t->cols + i;
+                    const uint64_t now = tile_hash(dst, ty, i);
+                    hash ^= *old ^ now;
+                    *old = now;
+                }
+            }
+            tx = end;
+        }
+        t->row_hash[ty] = hash;
+        if (changed && t->tracking & TILES_STATS) roll_up_row(t, ty);
+        t->row_stats[ty].births = births;
+        t->row_stats[ty].deaths = deaths;
+    }
+}
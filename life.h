@@ -0,0 +1,283 @@
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rule.h"
+
+// Bit-packed life kernel.
+//
+// A row of `width` cells is stored as (width + 63) / 64 words, cell x lives
+// in bit x % 64 of word x / 64. Every row is followed by at least one zero
+// padding word (which doubles as the left halo of the next row) and the grid
+// carries one zero halo row above and below, so the kernel can load neighbors
+// without any bounds checks. Bits past `width` in the last word of a row are
+// kept zero.
+//
+// Grids for Generations rules carry extra planes laid out the same way, one
+// bit of the dying counter each (see rule.h). Plane 0 holds the live cells
+// and is the only one neighbors are counted on.
+
+#define LIFE_WORDS(width) (((width) + 63) / 64)
+#define LIFE_LINE_WORDS 8 // one 64 byte cache line
+
+typedef struct Grid {
+    int width, height;
+    int words;          // words per row holding cells
+    ptrdiff_t stride;   // words between rows, a multiple of a cache line
+    int planes;
+    ptrdiff_t plane_stride; // words between planes
+    void *mem;          // what SDL_calloc returned
+    uint64_t *cells;    // first word of row 0, cache line aligned
+} grid_t;
+
+// How the edges of a board join up. The kernel never looks: before a step
+// grid_wrap() copies the cells across each edge into the halo (the halo
+// rows, bit 63 of the word left of each row and the bit right of its last
+// cell) and afterwards grid_unwrap() clears it again, so changing the
+// topology costs a row and a column per generation and the plane nothing.
+typedef enum Topology {
+    TOPOLOGY_PLANE,     // dead beyond the edges
+    TOPOLOGY_TORUS,     // opposite edges joined straight
+    TOPOLOGY_KLEIN,     // left and right straight, top and bottom mirrored
+    TOPOLOGY_CROSS,     // both mirrored, the real projective plane
+    TOPOLOGIES
+} topology_t;
+
+// Change tracking for life_step_tiles(). A tile is one word column wide and
+// LIFE_TILE_ROWS rows high, i.e. 64x64 cells.
+#define LIFE_TILE_ROWS 64
+
+// Live cells on a board, dying ones of Generations rules don't count.
+typedef struct LifeStats {
+    uint64_t population;
+    uint64_t births, deaths;    // in the last step
+    int x0, y0, x1, y1;         // bounding box, inclusive, x1 < x0 if empty
+} life_stats_t;
+
+typedef struct Tiles {
+    int cols, rows;
+    // changed: the tile changed in the last step (or was edited since),
+    // next: written by the step in progress, swapped in by tiles_swap()
+    uint8_t *changed, *next;
+    // What of the below is kept up to date, see tiles_track()
+    int tracking;
+    // hash: grid_hash() of the grid the last step produced. The step
+    // rehashes the tiles it changed into tile_hash and leaves how that moved
+    // the total in row_hash for tiles_swap() to fold in
+    uint64_t hash;
+    uint64_t *row_hash, *tile_hash;
+    // stats: of the grid the last step produced. The step recounts the
+    // tiles it changed (live cells and which columns and rows hold any) and
+    // sums them up per tile row, tiles_swap() adds up the rows
+    life_stats_t stats;
+    life_stats_t *row_stats;
+    uint32_t *tile_pop;
+    uint64_t *tile_cols, *tile_rows;
+} tiles_t;
+
+// Heap allocates a dead width x height grid, false if out of memory.
+bool grid_create(grid_t *g, int width, int height);
+bool grid_create_planes(grid_t *g, int width, int height, int planes);
+void grid_destroy(grid_t *g);
+void grid_clear(grid_t *g);
+// 64-bit hash of every cell of g, the XOR of the hashes of its tiles.
+uint64_t grid_hash(const grid_t *g);
+
+// Fills in / clears the halo of g for the topology set with
+// life_set_topology(), both do nothing on the plane. Until it's unwrapped a
+// wrapped grid may hold a live bit past `width`.
+void grid_wrap(grid_t *g);
+void grid_unwrap(grid_t *g);
+
+static inline uint64_t *grid_row(const grid_t *g, const int y) {
+    return g->cells + y * g->stride;
+}
+
+static inline uint64_t *grid_plane_row(const grid_t *g, const int plane, const int y) {
+    return g->cells + plane * g->plane_stride + y * g->stride;
+}
+
+static inline int grid_get(const grid_t *g, const int y, const int x) {
+    return (int) (grid_row(g, y)[x / 64] >> (x % 64)) & 1;
+}
+
+// 0 dead, 1 alive, 2 and up dying
+static inline int grid_state(const grid_t *g, const int y, const int x) {
+    if (grid_get(g, y, x)) return 1;
+    int dying = 0;
+    for (int p = 1; p < g->planes; p++) {
+        dying |= (int) (grid_plane_row(g, p, y)[x / 64] >> (x % 64) & 1) << (p - 1);
+    }
+    return dying ? dying + 1 : 0;
+}
+
+static inline void grid_set(grid_t *g, const int y, const int x, const int alive) {
+    // The halo has to stay dead or the kernel would see ghost neighbors
+    if (y < 0 || y >= g->height || x < 0 || x >= g->width) return;
+    uint64_t *word = &grid_row(g, y)[x / 64];
+    const uint64_t bit = UINT64_C(1) << (x % 64);
+    *word = alive ? *word | bit : *word & ~bit;
+    for (int p = 1; p < g->planes; p++) {
+        grid_plane_row(g, p, y)[x / 64] &= ~bit;
+    }
+}
+
+static inline int life_popcount(const uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    uint64_t v = w - ((w >> 1) & UINT64_C(0x5555555555555555));
+    v = (v & UINT64_C(0x3333333333333333)) + ((v >> 2) & UINT64_C(0x3333333333333333));
+    v = (v + (v >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return (int) ((v * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+// Index of the lowest and highest set bit, w can't be 0
+static inline int life_lowest_bit(const uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    int i = 0;
+    while (!(w >> i & 1)) i++;
+    return i;
+#endif
+}
+
+static inline int life_highest_bit(const uint64_t w) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(w);
+#else
+    int i = 63;
+    while (!(w >> i & 1)) i--;
+    return i;
+#endif
+}
+
+// Next Conway state of a word (or vector of words) of cells.
+// a, r, b are the rows above, at and below the cells, *p / *n are the same
+// rows loaded one word to the left / right so the shifted neighbors can pull
+// in the bit that crosses the word boundary.
+//
+// The eight neighbors are summed with plain adder logic: a full adder per
+// outer row, a half adder for the middle row, then one more full adder over
+// the low bits. That leaves count = s0 + 2 * (u1 + l1 + m1 + c0), and a cell
+// is alive next generation iff exactly one of those twos is set and either
+// s0 is set (3 neighbors) or the cell is already alive (2 neighbors).
+#define LIFE_NEXT(T, out, a, ap, an, r, rp, rn, b, bp, bn) do {         \
+    const T nw_ = ((a) << 1) | ((ap) >> 63), ne_ = ((a) >> 1) | ((an) << 63); \
+    const T w_  = ((r) << 1) | ((rp) >> 63), e_  = ((r) >> 1) | ((rn) << 63); \
+    const T sw_ = ((b) << 1) | ((bp) >> 63), se_ = ((b) >> 1) | ((bn) << 63); \
+    const T u0_ = nw_ ^ (a) ^ ne_, u1_ = (nw_ & (a)) | (ne_ & (nw_ ^ (a))); \
+    const T l0_ = sw_ ^ (b) ^ se_, l1_ = (sw_ & (b)) | (se_ & (sw_ ^ (b))); \
+    const T m0_ = w_ ^ e_, m1_ = w_ & e_;                                   \
+    const T s0_ = u0_ ^ l0_ ^ m0_, c0_ = (u0_ & l0_) | (m0_ & (u0_ ^ l0_)); \
+    const T k1_ = (u1_ ^ l1_ ^ m1_ ^ c0_) & ~((u1_ & l1_) | (m1_ & c0_));  \
+    (out) = k1_ & (s0_ | (r));                                              \
+} while (0)
+
+// Neighbor count of every cell as four bit planes, count = k0 + 2 k1 +
+// 4 k2 + 8 k3. Same adders as LIFE_NEXT, then the twos u1 + l1 + m1 + c0
+// (at most 4) are summed into k1..k3: two half adders give t0 and the
+// carries, and at most two carries can be set at once since u1 & l1 clears
+// u1 ^ l1 (likewise for m1 & c0).
+#define LIFE_COUNT(T, k0, k1, k2, k3, a, ap, an, r, rp, rn, b, bp, bn)     \
+    const T nw_ = ((a) << 1) | ((ap) >> 63), ne_ = ((a) >> 1) | ((an) << 63); \
+    const T w_  = ((r) << 1) | ((rp) >> 63), e_  = ((r) >> 1) | ((rn) << 63); \
+    const T sw_ = ((b) << 1) | ((bp) >> 63), se_ = ((b) >> 1) | ((bn) << 63); \
+    const T u0_ = nw_ ^ (a) ^ ne_, u1_ = (nw_ & (a)) | (ne_ & (nw_ ^ (a))); \
+    const T l0_ = sw_ ^ (b) ^ se_, l1_ = (sw_ & (b)) | (se_ & (sw_ ^ (b))); \
+    const T m0_ = w_ ^ e_, m1_ = w_ & e_;                                   \
+    const T k0 = u0_ ^ l0_ ^ m0_, c0_ = (u0_ & l0_) | (m0_ & (u0_ ^ l0_));  \
+    const T x_ = u1_ ^ l1_, xc_ = u1_ & l1_, y_ = m1_ ^ c0_, yc_ = m1_ & c0_; \
+    const T k1 = x_ ^ y_, k2 = (x_ & y_) ^ xc_ ^ yc_, k3 = xc_ & yc_
+
+// One neighbor count of a rule: the cells with exactly n neighbors that are
+// born (dead, n in birth) or survive (alive, n in survive). The masks are
+// all ones or zero, so with constant rules whole terms fold away.
+#define LIFE_RULE_MASK_(counts, n) (UINT64_C(0) - ((uint64_t) (counts) >> (n) & 1))
+#define LIFE_RULE_TERM_(n, birth, survive, r, k0, k1, k2, k3)              \
+    (((n) & 1 ? (k0) : ~(k0)) & ((n) & 2 ? (k1) : ~(k1))                    \
+     & ((n) & 4 ? (k2) : ~(k2)) & ((n) & 8 ? (k3) : ~(k3))                  \
+     & ((~(r) & LIFE_RULE_MASK_(birth, n)) | ((r) & LIFE_RULE_MASK_(survive, n))))
+
+// LIFE_NEXT for any birth / survive counts (see rule.h). Inlined with
+// constant counts this compiles down to just the terms the rule uses, and
+// B3/S23 goes through the shorter LIFE_NEXT.
+#define LIFE_NEXT_RULE(T, out, birth, survive, a, ap, an, r, rp, rn, b, bp, bn) do { \
+    if ((birth) == 1 << 3 && (survive) == (1 << 2 | 1 << 3)) {              \
+        LIFE_NEXT(T, out, a, ap, an, r, rp, rn, b, bp, bn);                 \
+    } else {                                                                \
+        LIFE_COUNT(T, k0_, k1_, k2_, k3_, a, ap, an, r, rp, rn, b, bp, bn); \
+        (out) = LIFE_RULE_TERM_(0, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(1, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(2, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(3, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(4, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(5, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(6, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(7, birth, survive, r, k0_, k1_, k2_, k3_)   \
+              | LIFE_RULE_TERM_(8, birth, survive, r, k0_, k1_, k2_, k3_);  \
+    }                                                                       \
+} while (0)
+
+// Tracks the tiles of a grid, everything starts out changed so the first step
+// touches the whole board.
+bool tiles_create(tiles_t *t, const grid_t *g);
+void tiles_destroy(tiles_t *t);
+void tiles_mark_all(tiles_t *t);
+void tiles_swap(tiles_t *t);
+// Starts keeping t->hash and / or t->stats up to date from g on. Each costs
+// the step about a third on busy boards, nothing on quiet ones.
+#define TILES_HASH 1
+#define TILES_STATS 2
+void tiles_track(tiles_t *t, const grid_t *g, int what);
+// Edits don't keep t->hash or t->stats up to date, this catches them up on
+// the tiles the edits flagged.
+void tiles_refresh(tiles_t *t, const grid_t *g);
+
+// Flags the tile holding cell (y, x) after an edit outside the stepper.
+static inline void tiles_mark(tiles_t *t, const int y, const int x) {
+    if (y < 0 || y >= t->rows * LIFE_TILE_ROWS || x < 0 || x >= t->cols * 64) return;
+    t->changed[(y / LIFE_TILE_ROWS) * t->cols + x / 64] = 1;
+}
+
+// Picks the widest kernel the cpu supports (AVX2, SSE2 or plain 64-bit)
+// and sets the rule to Conway's.
+void life_init(void);
+const char *life_kernel_name(void);
+
+// Switches every following step to `rule`. Common rules have a kernel of
+// their own with the counts baked in, the rest share a generic one. Grids
+// stepped from then on need rule_planes(rule) planes.
+void life_set_rule(const rule_t *rule);
+// The specialized kernel in use, "generic" or "generations" if none.
+const char *life_rule_kernel_name(void);
+
+// Joins the edges of every board stepped from then on, src has to be
+// wrapped with grid_wrap() before each step and unwrapped after.
+void life_set_topology(topology_t topology);
+topology_t life_topology(void);
+// "plane", "torus", "klein" or "cross", topology_parse() takes the same
+// names. False if it's none of those.
+const char *topology_name(topology_t topology);
+bool topology_parse(topology_t *topology, const char *str);
+
+// Computes the next generation of rows [y0, y1) from src into dst, which
+// must have the same dimensions.
+void life_step_rows(const grid_t *src, grid_t *dst, int y0, int y1);
+// Same for words [w0, w1) of each row, the rest of dst is left alone.
+void life_step_words(const grid_t *src, grid_t *dst, int y0, int y1, int w0, int w1);
+
+// Like life_step_rows() for tile rows [ty0, ty1), but only recomputes tiles
+// which changed or have a changed neighbor and records which of those did
+// change in t->next, recounting and rehashing those as tracked.
+// Every other tile is skipped outright: it can't change, and because it
+// didn't change last step either dst already holds the same cells as src.
+// That only works as long as dst is the grid src was stepped from and every
+// edit in between went through tiles_mark().
+void life_step_tiles(const grid_t *src, grid_t *dst, tiles_t *t, int ty0, int ty1);
+
+#endif
@@ -0,0 +1,206 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "ltl.h"
+
+// Blocks of rows and words stepped together, the running sums start over
+// for every one
+#define BLOCK_ROWS 64
+#define BLOCK_WORDS 8
+#define SPAN (BLOCK_WORDS * 64)
+// The diamond recurrence reads the columns either side of the one it
+// computes, so the columns it can't compute go stale a column further in
+// every row. Starting this far out the stale ones never reach the block
+#define MARGIN (BLOCK_ROWS + 2)
+
+typedef struct Counter {
+    const rule_t *rule;
+    const grid_t *g;
+    int y0, x0, x1;         // the block's first row and its cells
+    // Moore: live cells in the 2r + 1 rows around the current one, for
+    // columns x0 - r on
+    uint16_t cols[SPAN + 2 * RULE_MAX_RADIUS];
+    // von Neumann: live cells in the diamond around each of columns
+    // x0 - MARGIN on, for the current row and the two above
+    uint16_t diamonds[3][SPAN + 2 * MARGIN];
+    // Discs: half the width of each row, and how much the count changes
+    // from each cell of the current row to the next
+    int widths[2 * RULE_MAX_RADIUS + 1];
+    uint16_t steps[SPAN];
+} counter_t;
+
+static inline const uint64_t *row_at(const grid_t *g, const int y) {
+    return y >= 0 && y < g->height ? grid_row(g, y) : NULL;
+}
+
+static inline int bit(const grid_t *g, const uint64_t *row, const int x) {
+    if (!row || x < 0 || x >= g->width) return 0;
+    return (int) (row[x / 64] >> (x % 64) & 1);
+}
+
+// Live cells in [x0, x1] of row y
+static int span_count(const grid_t *g, const int y, int x0, int x1) {
+    const uint64_t *row = row_at(g, y);
+    x0 = SDL_max(x0, 0);
+    x1 = SDL_min(x1, g->width - 1);
+    if (!row || x0 > x1) return 0;
+    const int a = x0 / 64, b = x1 / 64;
+    const uint64_t first = ~UINT64_C(0) << (x0 % 64), last = ~UINT64_C(0) >> (63 - x1 % 64);
+    if (a == b) return life_popcount(row[a] & first & last);
+    int n = life_popcount(row[a] & first) + life_popcount(row[b] & last);
+    for (int w = a + 1; w < b; w++) n += life_popcount(row[w]);
+    return n;
+}
+
+// Adds (or with sign -1 takes) cell from + i of row to sums[i] for i in
+// [0, n), a word of cells at a time. Rows and cells off the board are dead
+static void add_cells(uint16_t *sums, const grid_t *g, const uint64_t *row, const int from, const int n, const int sign) {
+    if (!row) return;
+    const int x1 = SDL_min(from + n, g->width);
+    for (int x = SDL_max(from, 0); x < x1;) {
+        uint64_t w = row[x / 64] >> (x % 64);
+        uint16_t *sum = sums + (x - from);
+        for (const int end = SDL_min(x1, (x / 64 + 1) * 64); x < end; x++, w >>= 1) {
+            *sum = (uint16_t) (*sum + sign * (int) (w & 1));
+            sum++;
+        }
+    }
+}
+
+static void moore_row(counter_t *c, const int y, const bool first, uint16_t *out) {
+    const grid_t *g = c->g;
+    const int r = c->rule->radius, from = c->x0 - r, n = c->x1 - c->x0 + 2 * r;
+    if (first) {
+        memset(c->cols, 0, (size_t) n * sizeof(uint16_t));
+        for (int dy = -r; dy <= r; dy++) add_cells(c->cols, g, row_at(g, y + dy), from, n, 1);
+    } else {
+        add_cells(c->cols, g, row_at(g, y + r), from, n, 1);
+        add_cells(c->cols, g, row_at(g, y - r - 1), from, n, -1);
+    }
+    uint32_t sum = 0;
+    for (int i = 0; i <= 2 * r; i++) sum += c->cols[i];
+    out[0] = (uint16_t) sum;
+    for (int j = 1; j < c->x1 - c->x0; j++) {
+        sum += (uint32_t) c->cols[j + 2 * r] - c->cols[j - 1];
+        out[j] = (uint16_t) sum;
+    }
+}
+
+static int diamond(const grid_t *g, const int y, const int x, const int r) {
+    int n = 0;
+    for (int dy = -r; dy <= r; dy++) {
+        const int w = r - SDL_abs(dy);
+        n += span_count(g, y + dy, x - w, x + w);
+    }
+    return n;
+}
+
+static void von_neumann_row(counter_t *c, const int y, const bool first, uint16_t *out) {
+    const grid_t *g = c->g;
+    const int r = c->rule->radius, from = c->x0 - MARGIN, n = c->x1 - c->x0 + 2 * MARGIN;
+    // Rows y0 - 2 and y0 - 1 go in 0 and 1
+    const int k = (y - c->y0 + 2) % 3;
+    uint16_t *now = c->diamonds[k], *up = c->diamonds[(k + 2) % 3], *up2 = c->diamonds[(k + 1) % 3];
+    if (first) {
+        for (int i = 0; i < n; i++) {
+            up2[i] = (uint16_t) diamond(g, y - 2, from + i, r);
+            up[i] = (uint16_t) diamond(g, y - 1, from + i, r);
+        }
+        now[0] = now[n - 1] = 0;
+    }
+    const uint64_t *top = row_at(g, y - r - 2), *top1 = row_at(g, y - r - 1), *side = row_at(g, y - 1);
+    const uint64_t *bottom1 = row_at(g, y + r - 1), *bottom = row_at(g, y + r);
+    for (int i = 1; i < n - 1; i++) {
+        const int x = from + i;
+        const int tips = bit(g, bottom1, x) + bit(g, bottom, x) + bit(g, top1, x) + bit(g, top, x);
+        const int sides = bit(g, side, x - r - 1) + bit(g, side, x - r) + bit(g, side, x + r) + bit(g, side, x + r + 1);
+        now[i] = (uint16_t) (up[i - 1] + up[i + 1] - up2[i] + tips - sides);
+    }
+    memcpy(out, now + MARGIN, (size_t) (c->x1 - c->x0) * sizeof(uint16_t));
+}
+
+// The disc's first cell is counted span by span. Moving one cell right,
+// every row of the disc gains the cell past its right end and loses its
+// leftmost one, which for all the cells of a row are two streams of bits
+// offset from each other
+static void circular_row(counter_t *c, const int y, const bool first, uint16_t *out) {
+    const grid_t *g = c->g;
+    const int r = c->rule->radius, n = c->x1 - c->x0;
+    if (first) {
+        for (int dy = -r; dy <= r; dy++) c->widths[dy + r] = (int) SDL_floor(SDL_sqrt((double) (r * r + r - dy * dy)));
+    }
+    int count = 0;
+    memset(c->steps, 0, (size_t) n * sizeof(uint16_t));
+    for (int dy = -r; dy <= r; dy++) {
+        const uint64_t *row = row_at(g, y + dy);
+        if (!row) continue;
+        const int w = c->widths[dy + r];
+        count += span_count(g, y + dy, c->x0 - w, c->x0 + w);
+        add_cells(c->steps + 1, g, row, c->x0 + 1 + w, n - 1, 1);
+        add_cells(c->steps + 1, g, row, c->x0 - w, n - 1, -1);
+    }
+    out[0] = (uint16_t) count;
+    for (int i = 1; i < n; i++) out[i] = (uint16_t) (out[i - 1] + c->steps[i]);
+}
+
+// Generations ageing of word i of row y, as in the kernels in life.c:
+// dying cells can't be born, live cells that don't survive start dying and
+// the dying counter counts up until it reaches the last state
+static void age(const rule_t *rule, const grid_t *src, grid_t *dst, const int y, const int i, uint64_t next) {
+    const int bits = src->planes - 1;
+    const unsigned last_state = (unsigned) rule->states - 2;
+    uint64_t d[8], dying = 0, last = ~UINT64_C(0);
+    for (int p = 0; p < bits; p++) {
+        d[p] = grid_plane_row(src, p + 1, y)[i];
+        dying |= d[p];
+        last &= last_state >> p & 1 ? d[p] : ~d[p];
+    }
+    next &= ~dying;
+    uint64_t carry = dying;
+    for (int p = 0; p < bits; p++) {
+        const uint64_t sum = d[p] ^ carry;
+        carry &= d[p];
+        d[p] = sum & ~(dying & last);
+    }
+    if (bits) d[0] |= grid_row(src, y)[i] & ~next;
+    grid_row(dst, y)[i] = next;
+    for (int p = 0; p < bits; p++) grid_plane_row(dst, p + 1, y)[i] = d[p];
+}
+
+static void step_block(counter_t *c, grid_t *dst, const int y0, const int y1, const int w0, const int w1) {
+    const rule_t *rule = c->rule;
+    const grid_t *src = c->g;
+    c->y0 = y0;
+    c->x0 = w0 * 64;
+    c->x1 = SDL_min(w1 * 64, src->width);
+    uint16_t counts[SPAN];
+    for (int y = y0; y < y1; y++) {
+        switch (rule->neighborhood) {
+            case NEIGHBORHOOD_MOORE: moore_row(c, y, y == y0, counts); break;
+            case NEIGHBORHOOD_VON_NEUMANN: von_neumann_row(c, y, y == y0, counts); break;
+            case NEIGHBORHOOD_CIRCULAR: circular_row(c, y, y == y0, counts); break;
+        }
+        const uint64_t *row = grid_row(src, y);
+        for (int w = w0; w < w1; w++) {
+            uint64_t next = 0;
+            for (int x = w * 64; x < SDL_min(w * 64 + 64, c->x1); x++) {
+                const int alive = (int) (row[w] >> (x % 64) & 1);
+                const int n = counts[x - c->x0] - (rule->middle ? 0 : alive);
+                const bool on = alive ? n >= rule->survive_min && n <= rule->survive_max : n >= rule->birth_min && n <= rule->birth_max;
+                next |= (uint64_t) on << (x % 64);
+            }
+            if (src->planes > 1) age(rule, src, dst, y, w, next);
+            else grid_row(dst, y)[w] = next;
+        }
+    }
+}
+
+void ltl_step(const rule_t *rule, const grid_t *src, grid_t *dst, const int y0, const int y1, const int w0, const int w1) {
+    counter_t c;
+    c.rule = rule;
+    c.g = src;
+    for (int by = y0; by < y1; by += BLOCK_ROWS) {
+        for (int bw = w0; bw < w1; bw += BLOCK_WORDS) {
+            step_block(&c, dst, by, SDL_min(by + BLOCK_ROWS, y1), bw, SDL_min(bw + BLOCK_WORDS, w1));
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef LTL_H
+#define LTL_H
+
+#include "life.h"
+#include "rule.h"
+
+// Larger than Life stepping (see rule.h), on bit-packed grids like the
+// kernels in life.c but a cell at a time.
+//
+// Counting every neighbor would cost (2r + 1)^2 per cell. Instead the
+// counts are kept as running sums while going down the rows of a block:
+// - Moore: each column's count over the 2r + 1 rows around the current
+//   one gains a row at the bottom and loses one at the top, and a cell's
+//   count is a window of 2r + 1 of those column counts, slid along the row.
+// - von Neumann: diamonds overlap so that the one at (x, y) is the two at
+//   (x - 1, y - 1) and (x + 1, y - 1), less the one at (x, y - 2), give or
+//   take their 8 tips, so each row follows from the two above.
+// Both are O(1) per cell whatever the radius. Discs have no such
+// recurrence: sliding one along a row, each of its 2r + 1 rows gains a
+// cell and loses one, so they're O(r), a pair of shifted bits per row.
+//
+// Only the plane is supported, the halo of a grid is a single cell deep.
+
+// Steps words [w0, w1) of rows [y0, y1) of src into dst under `rule`,
+// dying states included. The rest of dst is left alone.
+void ltl_step(const rule_t *rule, const grid_t *src, grid_t *dst, int y0, int y1, int w0, int w1);
+
+#endif
@@ -1,167 +1,1292 @@
 #include <stdbool.h>
+#include <stdio.h>
 #include "SDL2/SDL.h"
+#include "census.h"
+#include "checkpoint.h"
+#include "cycle.h"
+#include "hashlife.h"
+#include "history.h"
+#include "lenia.h"
+#include "life.h"
+#include "pattern.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "soup.h"
+#include "universe.h"
+#include "view.h"
 
+// Defaults, override with --width / --height / --cell-size / --threads /
+// --fast-forward or the GOLC_WIDTH / GOLC_HEIGHT / GOLC_CELL_SIZE /
+// GOLC_THREADS / GOLC_FAST_FORWARD environment variables. THREADS 0 means
+// one per cpu, F skips 2^FAST_FORWARD generations ahead.
+// --gps / GOLC_GPS is the target generations per second, 0 steps as fast as
+// possible, and --fps / GOLC_FPS caps how often the board is drawn.
+// --headless (or GOLC_HEADLESS=1) opens no window and just steps the board
+// --generations times as fast as it can, then prints a JSON summary.
+// --rule / GOLC_RULE picks the rule, e.g. B36/S23 or B2/S345/C4, or a
+// Larger than Life one like R5,C0,M1,S34..58,B34..45,NM (see rule.h). Those
+// only run on a bounded plane without checkpoints or fast forward.
+// --pattern / GOLC_PATTERN loads an .rle or .mc file, whose rule is used
+// unless --rule says otherwise. Files dropped on the window load too.
+// --checkpoint / GOLC_CHECKPOINT saves the board to a file every
+// CHECKPOINT_EVERY seconds (--checkpoint-every / GOLC_CHECKPOINT_EVERY) and
+// on exit, and resumes from it on startup. --seed / GOLC_SEED seeds the
+// soups R scatters over the board, --density / GOLC_DENSITY is how full
+// they are in percent.
+// --stress-test / GOLC_STRESS_TEST starts out from a soup over the whole
+// board (unless resuming) and logs how long filling it took.
+// --census / GOLC_CENSUS runs that many 16x16 soups from --seed on every
+// thread until they settle instead, and prints the objects they left behind
+// as JSON (see census.h). Two state rules on the plane only.
+// --history-mb / GOLC_HISTORY_MB caps the memory kept for rewinding the board
+// with Left (Right goes forward again), 0 turns it off. That includes a copy
+// of the board, rewinding is off if it can't even hold that. Shift moves
+// SCRUB_STEPS at a time, a keyframe is kept every HISTORY_KEYFRAME entries.
+// A board that settles into a still life or an oscillator with a period of
+// up to MAX_PERIOD pauses itself until it's edited.
+// I toggles the overlay with the generation, population, births and deaths
+// of the last step and the bounding box of the live cells.
+// The wheel zooms around the mouse pointer, from MAX_ZOOM pixels per cell
+// out to half the size that fits the whole board, which Home goes back to.
+// Dragging with the right or middle button pans.
+// --unbounded / GOLC_UNBOUNDED steps an unbounded plane instead of the board,
+// which then shows the part of it from the origin on: patterns leaving it
+// carry on outside rather than dying at the edge. Fast forward, rewinding
+// and pausing settled boards would only see the board, so they're off
+// --topology / GOLC_TOPOLOGY joins the edges of the board: plane (the
+// default), torus, klein (top and bottom mirrored) or cross (both mirrored)
+// --lenia / GOLC_LENIA runs Lenia, a continuous automaton, instead, e.g.
+// orbium or R13,T10,M0.15,S0.015,B1 (see lenia.h). The board is rounded up
+// to powers of two and wraps around, R and the left button drop soup on
+// it. There's no fast forward, rewinding, checkpoints or census for it.
+// --software / GOLC_SOFTWARE draws straight into the window's pixels rather
+// than through a renderer, which is what happens anyway when there's no
+// hardware accelerated one.
 #define WIDTH 80
 #define HEIGHT 40
 #define CELL_SIZE 20
+#define THREADS 0
+#define FAST_FORWARD 10
+#define GENERATIONS 1000
+#define GPS 5
+#define FPS 60
+#define CHECKPOINT_EVERY 30
+#define SEED 1
+#define SOUP_DENSITY 35 // percent
+#define HISTORY_MB 64
+#define HISTORY_KEYFRAME 256
+#define SCRUB_STEPS 100
+#define MAX_PERIOD 1024
+#define OVERLAY_SCALE 2 // screen pixels per font pixel
+#define ZOOM_STEP 1.25 // per notch of the wheel
+#define MAX_ZOOM 64
+// Seconds of generations the scheduler will still catch up on, anything
+// further behind is dropped so a slow board doesn't spiral
+#define MAX_BACKLOG 0.25
+// Milliseconds an idle window sleeps waiting for events, publishing and
+// input wake it up sooner
+#define IDLE_WAIT 1000
+
+// The window never grows past this, bigger boards start out showing their
+// top left corner
+#define MAX_WINDOW_WIDTH 1600
+#define MAX_WINDOW_HEIGHT 800
 
 typedef struct State {
     SDL_Window *window;
     SDL_Renderer *renderer;
-    int grid[HEIGHT][WIDTH];
+    SDL_Texture *texture; // a texel per sample of a view
+    // Without a hardware renderer the window's own pixels, drawn straight
+    // into instead (see draw_surface())
+    SDL_Surface *surface;
+    int *sample_x, *sample_y;   // the sample of the view at each pixel column / row, -1 for none
+    SDL_Rect overlay_back;      // where the overlay was drawn into the surface
+    // How the view the texture holds was sampled, it only needs the damage
+    // of the next one uploaded if that's the same. The surface also needs
+    // the same camera
+    struct Drawn {
+        bool valid;
+        int level, x, y, width, height;
+        camera_t camera;
+    } drawn;
+    int width, height, cell_size;
+    int window_width, window_height;
+    camera_t camera;    // only moved while holding `lock`
+    // Double buffered, update_grid() steps grid into next and swaps them.
+    // Edits have to go through set_cell() / mark_all() so the stepper
+    // knows to look at those tiles again
+    grid_t grid, next;
+    tiles_t tiles;
+    mips_t mips;        // windowed only
+
+    // With a window the board belongs to the sim thread, which publishes
+    // what the camera sees of every batch of generations through the
+    // pipeline.
+    // Everything above is only touched while holding `lock`
+    SDL_Thread *sim;
+    SDL_mutex *lock;
+    SDL_sem *wake;              // posted after every edit
+    SDL_atomic_t edits_waiting; // the render thread is queueing for the lock
+    SDL_atomic_t sim_quit;
+    // The render thread sleeps in SDL_WaitEventTimeout() until there's
+    // something new to draw, publishing wakes it up with one of these
+    Uint32 published_event;
+    SDL_atomic_t published_posted; // one's waiting in the queue already
+    bool redraw;                   // the window needs drawing regardless
+    bool edited;                // republish even if nothing was stepped
+    pipeline_t pipeline;
+    pool_t *pool;
+    hashlife_t *hashlife;
+    rule_t rule;
+    bool hashlife_rule;         // HashLife can run the rule
+    uint64_t generation;
+    uint64_t rng;               // soup_next() state
+    checkpoint_t *checkpoint;
+    int checkpoint_every;
+    history_t *history;         // every step and edit since, windowed only
+    cycle_t *cycle;             // windowed only too
+    bool settled;               // paused for repeating itself, until edited
+    universe_t *universe;       // the board is a window onto it if unbounded
+    lenia_t *lenia;             // runs instead of the grid if set
+    int fast_forward;
     bool running;
     bool paused;
     bool stress_test;
+    int density;                // of soups, percent
+    int census;                 // soups to search, none to run the board
+    bool overlay;
+    bool headless;
+    int generations;
+    int gps, fps;
 
     struct Mouse {
-        int x, y;
+        int x, y;       // the window pixel the pointer was last seen at
     } mouse;
 } state_t;
 
 state_t state;
 
-int getNeighbors(const int y, const int x) {
-    int neighbors = 0;
-
-    for (int dy = -1; dy <= 1; dy++) {
-        for (int dx = -1; dx <= 1; dx++) {
-            if (dx != 0 || dy != 0) {
-                const int ny = y + dy;
-                const int nx = x + dx;
-                if (ny >= 0
-                        && ny < HEIGHT
-                        && nx >= 0
-                        && nx < WIDTH) {
-                    neighbors += state.grid[ny][nx];
-                }
+int get_cell(const int y, const int x) {
+    if (y < 0 || y >= state.height || x < 0 || x >= state.width) return 0;
+    if (state.lenia) return state.lenia->cells[(size_t) y * state.width + x] > 0;
+    return grid_get(&state.grid, y, x);
+}
+
+void set_cell(const int y, const int x, const int alive) {
+    if (state.lenia) {
+        if (y >= 0 && y < state.height && x >= 0 && x < state.width) state.lenia->cells[(size_t) y * state.width + x] = (float) alive;
+        return;
+    }
+    grid_set(&state.grid, y, x, alive);
+    tiles_mark(&state.tiles, y, x);
+}
+
+void mark_all() {
+    tiles_mark_all(&state.tiles);
+}
+
+// Dead cells get a faint checkerboard, ARGB8888
+static const Uint32 palette[2][2] = {
+    {0xFF000000, 0xFF141414}, // dead, by (x + y) % 2
+    {0xFF009600, 0xFF009600}, // alive
+};
+
+// Generations rules fade dying cells out towards the last state
+static Uint32 dying_palette[RULE_MAX_STATES];
+
+// Zoomed out, by how full a block is
+static Uint32 density_palette[256];
+
+// Lenia cells and blocks, by value: black through blue and green to yellow
+static Uint32 field_palette[256];
+
+void init_palette() {
+    for (int s = 2; s < state.rule.states; s++) {
+        const Uint32 green = (Uint32) (0x96 * (state.rule.states - s) / state.rule.states);
+        const Uint32 red = (Uint32) (0x60 * (state.rule.states - s) / state.rule.states);
+        dying_palette[s] = 0xFF000000 | red << 16 | green << 8;
+    }
+    // Even sparse blocks should stand out from empty ones
+    for (int d = 1; d < 256; d++) {
+        density_palette[d] = 0xFF000000 | (Uint32) (0x20 + (0xFF - 0x20) * SDL_sqrt(d / 255.0)) << 8;
+    }
+    density_palette[0] = palette[0][0];
+
+    static const Uint8 stops[][3] = {{0x00, 0x00, 0x00}, {0x10, 0x30, 0x90}, {0x00, 0xA0, 0x70}, {0xF0, 0xE0, 0x40}};
+    const int spans = (int) SDL_arraysize(stops) - 1;
+    for (int v = 0; v < 256; v++) {
+        const int i = SDL_min(v * spans / 255, spans - 1), from = i * 255 / spans, to = (i + 1) * 255 / spans;
+        Uint32 c = 0xFF000000;
+        for (int k = 0; k < 3; k++) c |= (Uint32) (stops[i][k] + (stops[i + 1][k] - stops[i][k]) * (v - from) / (to - from)) << (16 - 8 * k);
+        field_palette[v] = c;
+    }
+}
+
+// `parity` picks the square of the checkerboard
+Uint32 state_color(const int level, const int s, const int parity) {
+    if (state.lenia) return field_palette[s];
+    if (level) return density_palette[s];
+    return s > 1 ? dying_palette[s] : palette[s][parity];
+}
+
+Uint32 sample_color(const view_t *v, const int y, const int x) {
+    return state_color(v->level, v->samples[y * v->width + x], (v->x + x + v->y + y) % 2);
+}
+
+// One fill rect per sample, only used if the streaming texture couldn't be
+// made
+void render_rects(const view_t *v, const SDL_FRect *dst) {
+    const float size = dst->w / (float) v->width;
+    for (int y = 0; y < v->height; y++) {
+        for (int x = 0; x < v->width; x++) {
+            const SDL_FRect cell = {dst->x + x * size, dst->y + y * size, size, size};
+            const Uint32 color = sample_color(v, y, x);
+
+            SDL_SetRenderDrawColor(state.renderer, color >> 16 & 0xFF, color >> 8 & 0xFF, color & 0xFF, 255);
+            SDL_RenderFillRectF(state.renderer, &cell);
+        }
+    }
+}
+
+// Whether v was sampled like the view last drawn
+bool same_samples(const view_t *v) {
+    const struct Drawn *d = &state.drawn;
+    return d->valid && d->level == v->level && d->x == v->x && d->y == v->y && d->width == v->width && d->height == v->height;
+}
+
+// Writes samples `r` of a view into the texture, false if it couldn't
+bool upload(const view_t *v, const SDL_Rect *r) {
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(state.texture, r, &pixels, &pitch) != 0) return false;
+    for (int y = 0; y < r->h; y++) {
+        Uint32 *out = (Uint32 *) ((Uint8 *) pixels + (size_t) y * pitch);
+        for (int x = 0; x < r->w; x++) {
+            out[x] = sample_color(v, r->y + y, r->x + x);
+        }
+    }
+    SDL_UnlockTexture(state.texture);
+    return true;
+}
+
+// Expands a view into the streaming texture, one texel per sample, and lets
+// a single copy scale it up to where its camera puts it. Only the `damaged`
+// rects (see pipeline_latest_damage()) are uploaded if the texture holds a
+// view sampled the same way
+void render_grid(const view_t *v, const SDL_Rect *rects, const int damaged) {
+    SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(state.renderer);
+    if (!v->width || !v->height) return;
+
+    const double cells = (double) (1 << v->level); // per sample
+    const SDL_FRect dst = {
+        (float) ((v->x * cells - v->camera.x) * v->camera.zoom), (float) ((v->y * cells - v->camera.y) * v->camera.zoom),
+        (float) (v->width * cells * v->camera.zoom), (float) (v->height * cells * v->camera.zoom),
+    };
+    const SDL_Rect src = {0, 0, v->width, v->height};
+    bool uploaded = state.texture != NULL;
+    if (uploaded && same_samples(v) && damaged >= 0) {
+        for (int i = 0; i < damaged && uploaded; i++) uploaded = upload(v, &rects[i]);
+    } else if (uploaded) {
+        uploaded = upload(v, &src);
+    }
+    if (!uploaded) {
+        state.drawn.valid = false;
+        render_rects(v, &dst);
+        return;
+    }
+    state.drawn = (struct Drawn) {true, v->level, v->x, v->y, v->width, v->height, v->camera};
+    SDL_RenderCopyF(state.renderer, state.texture, &src, &dst);
+}
+
+// Pauses a board that has started repeating itself, it would only burn cpu
+void check_settled() {
+    const uint64_t period = cycle_check(state.cycle, state.tiles.hash, state.generation);
+    if (!period) return;
+    state.settled = true;
+    state.paused = true;
+    if (period == 1) SDL_Log("Still life since generation %llu, pausing", (unsigned long long) state.generation - 1);
+    else SDL_Log("Period %llu oscillator since generation %llu, pausing", (unsigned long long) period, (unsigned long long) (state.generation - period));
+}
+
+// 3x5 pixel glyphs, a row of three bits per line from the top
+static const struct Glyph {
+    char c;
+    Uint16 rows;
+} font[] = {
+    {'0', 075557}, {'1', 026227}, {'2', 071747}, {'3', 071717}, {'4', 055711},
+    {'5', 074717}, {'6', 074757}, {'7', 071111}, {'8', 075757}, {'9', 075717},
+    {'B', 065656}, {'D', 065556}, {'E', 074647}, {'G', 074557}, {'N', 065555},
+    {'O', 075557}, {'P', 075744}, {'X', 055255}, {'+', 002720}, {'-', 000700},
+    {',', 000024},
+};
+
+static SDL_Rect overlay_pixels[128 * 15];
+
+// Lays out the stats of the generation in the top left corner: its font
+// pixels into overlay_pixels, returns how many, and the backdrop into *back
+int layout_overlay(const uint64_t generation, const life_stats_t *s, SDL_Rect *back) {
+    char text[SDL_arraysize(overlay_pixels) / 15];
+    int n = SDL_snprintf(text, sizeof(text), "GEN %llu POP %llu +%llu -%llu", (unsigned long long) generation,
+                         (unsigned long long) s->population, (unsigned long long) s->births, (unsigned long long) s->deaths);
+    if (s->population) {
+        SDL_snprintf(text + n, sizeof(text) - (size_t) n, " BOX %d,%d %dX%d", s->x0, s->y0, s->x1 - s->x0 + 1, s->y1 - s->y0 + 1);
+    }
+
+    SDL_Rect *pixels = overlay_pixels;
+    int count = 0, x = 2 * OVERLAY_SCALE;
+    for (const char *c = text; *c; c++, x += 4 * OVERLAY_SCALE) {
+        for (size_t g = 0; g < SDL_arraysize(font); g++) {
+            if (font[g].c != *c) continue;
+            for (int bit = 0; bit < 15; bit++) {
+                if (!(font[g].rows >> (14 - bit) & 1)) continue;
+                pixels[count++] = (SDL_Rect) {x + bit % 3 * OVERLAY_SCALE, (2 + bit / 3) * OVERLAY_SCALE, OVERLAY_SCALE, OVERLAY_SCALE};
             }
         }
     }
-    return neighbors;
+    *back = (SDL_Rect) {0, 0, x + OVERLAY_SCALE, 9 * OVERLAY_SCALE};
+    return count;
 }
 
-void render_grid() {
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            SDL_Rect cell = {x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE};
+void render_overlay(const uint64_t generation, const life_stats_t *s) {
+    SDL_Rect back;
+    const int count = layout_overlay(generation, s, &back);
+    SDL_SetRenderDrawBlendMode(state.renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(state.renderer, &back);
+    SDL_SetRenderDrawColor(state.renderer, 255, 255, 255, 255);
+    SDL_RenderFillRects(state.renderer, overlay_pixels, count);
+}
+
+// The software path: the window surface is drawn into directly and
+// presented with SDL_UpdateWindowSurface(Rects), nothing goes through the
+// renderer's command queue. The surface keeps what was drawn, so with the
+// same view and camera only the damage and the overlay are redrawn and
+// pushed to the window
 
-            if (state.grid[y][x])
-                SDL_SetRenderDrawColor(state.renderer, 0, 150, 0, 255);
-            else if ((x + y) % 2)
-                SDL_SetRenderDrawColor(state.renderer, 20, 20, 20, 255);
-            else
-                SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 255);
+// Sample colors in the surface's format, by sample and checkerboard square
+static Uint32 surface_colors[256][2];
+static Uint32 surface_black;
 
-            SDL_RenderFillRect(state.renderer, &cell);
+void map_colors(const int level) {
+    const SDL_PixelFormat *f = state.surface->format;
+    for (int s = 0; s < (level ? 256 : RULE_MAX_STATES); s++) {
+        for (int parity = 0; parity < 2; parity++) {
+            const Uint32 c = state_color(level, s, parity);
+            surface_colors[s][parity] = SDL_MapRGB(f, c >> 16 & 0xFF, c >> 8 & 0xFF, c & 0xFF);
         }
     }
+    surface_black = SDL_MapRGB(f, 0, 0, 0);
 }
 
-void update_grid() {
-    int new_grid[HEIGHT][WIDTH];
-    memset(new_grid, 0, sizeof(new_grid));
+// Which sample of the `samples` from `first` on every one of `pixels`
+// pixels shows, going by its middle, -1 off the board
+void map_samples(int *out, const int pixels, const double from, const double zoom, const int level, const int first, const int samples) {
+    const double size = (double) (1 << level);
+    for (int p = 0; p < pixels; p++) {
+        const int s = (int) SDL_floor((from + (p + 0.5) / zoom) / size) - first;
+        out[p] = s >= 0 && s < samples ? s : -1;
+    }
+}
+
+// Fills pixels `r` of the surface from v: a row of pixels per row of
+// samples, each sample a run of one color, copied down over the pixel rows
+// below showing the same samples
+void expand(const view_t *v, const SDL_Rect *r) {
+    const int pitch = state.surface->pitch;
+    for (int py = r->y; py < r->y + r->h; py++) {
+        Uint32 *out = (Uint32 *) ((Uint8 *) state.surface->pixels + (size_t) py * pitch) + r->x;
+        const int sy = state.sample_y[py];
+        if (py > r->y && sy == state.sample_y[py - 1]) {
+            SDL_memcpy(out, (Uint8 *) out - pitch, (size_t) r->w * sizeof(Uint32));
+            continue;
+        }
+        if (sy < 0) {
+            for (int px = 0; px < r->w; px++) out[px] = surface_black;
+            continue;
+        }
+        const uint8_t *samples = v->samples + (size_t) sy * v->width;
+        const int *sx = state.sample_x + r->x;
+        for (int px = 0; px < r->w;) {
+            const int s = sx[px];
+            const Uint32 color = s < 0 ? surface_black : surface_colors[samples[s]][(v->x + s + v->y + sy) % 2];
+            const int end = px;
+            while (px < r->w && sx[px] == s) px++;
+            for (int i = end; i < px; i++) out[i] = color;
+        }
+    }
+}
 
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            const int neighbors = getNeighbors(y, x);
+// The pixels samples `r` of v cover, clipped to the window, false if none
+bool screen_rect(const view_t *v, const SDL_Rect *r, SDL_Rect *out) {
+    const double cells = (double) (1 << v->level), zoom = v->camera.zoom;
+    const int x0 = SDL_max((int) SDL_floor(((v->x + r->x) * cells - v->camera.x) * zoom), 0);
+    const int y0 = SDL_max((int) SDL_floor(((v->y + r->y) * cells - v->camera.y) * zoom), 0);
+    const int x1 = SDL_min((int) SDL_ceil(((v->x + r->x + r->w) * cells - v->camera.x) * zoom), state.window_width);
+    const int y1 = SDL_min((int) SDL_ceil(((v->y + r->y + r->h) * cells - v->camera.y) * zoom), state.window_height);
+    *out = (SDL_Rect) {x0, y0, x1 - x0, y1 - y0};
+    return x0 < x1 && y0 < y1;
+}
 
-            // Apply Conway's Game of Life rules
-            // 1. Any live cell with 2 or 3 live neighbors survives
-            // 2. Any dead cell with exactly 3 live neighbors becomes alive
-            // 3. All other cells die or stay dead
-            new_grid[y][x] = neighbors == 3 || (state.grid[y][x] && neighbors == 2);
+// Shades the overlay's backdrop and writes its font pixels
+void draw_overlay(const uint64_t generation, const life_stats_t *s, SDL_Rect *back) {
+    const int count = layout_overlay(generation, s, back);
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(back, &(SDL_Rect) {0, 0, state.window_width, state.window_height}, &clipped)) return;
+    *back = clipped;
+    // The renderer blends in black at 160 out of 255, keeping about 95 of
+    // every channel
+    for (int y = back->y; y < back->y + back->h; y++) {
+        Uint32 *row = (Uint32 *) ((Uint8 *) state.surface->pixels + (size_t) y * state.surface->pitch);
+        for (int x = back->x; x < back->x + back->w; x++) {
+            const Uint32 c = row[x];
+            row[x] = ((c & 0x00FF00FF) * 95 >> 8 & 0x00FF00FF) | ((c >> 8 & 0x00FF00FF) * 95 & 0xFF00FF00);
         }
     }
+    SDL_FillRects(state.surface, overlay_pixels, count, SDL_MapRGB(state.surface->format, 255, 255, 255));
+}
 
-    // Update mouse pos
-    int mx, my;
-    SDL_GetMouseState(&mx, &my);
-    state.mouse.y = my / CELL_SIZE;
-    state.mouse.x = mx / CELL_SIZE;
-    // printf("MOUSE POS: %d / %d\n", state.mouse.x, state.mouse.y);
+// Draws v, the overlay if it's on and presents them. Only `damaged` rects
+// (see pipeline_latest_damage()) need drawing if the surface holds a view
+// sampled the same way and seen through the same camera, everything is
+// presented if `all`
+void draw_surface(const view_t *v, const SDL_Rect *rects, const int damaged, const bool all,
+                  const uint64_t generation, const life_stats_t *stats) {
+    SDL_Surface *surface = SDL_GetWindowSurface(state.window);
+    if (!surface) return;
+    if (surface != state.surface) state.drawn.valid = false;
+    state.surface = surface;
+    if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0) return;
 
-    // Paste updated grid into viewable grid
+    const camera_t *c = &state.drawn.camera;
+    const bool full = damaged < 0 || !same_samples(v) || c->x != v->camera.x || c->y != v->camera.y || c->zoom != v->camera.zoom;
+    if (full) map_colors(v->level);
+    map_samples(state.sample_x, state.window_width, v->camera.x, v->camera.zoom, v->level, v->x, v->width);
+    map_samples(state.sample_y, state.window_height, v->camera.y, v->camera.zoom, v->level, v->y, v->height);
+
+    SDL_Rect update[PIPELINE_RECTS + 2];
+    int count = 0;
+    if (full) {
+        expand(v, &(SDL_Rect) {0, 0, state.window_width, state.window_height});
+    } else {
+        for (int i = 0; i < damaged; i++) {
+            if (screen_rect(v, &rects[i], &update[count])) expand(v, &update[count++]);
+        }
+        // What the overlay covered last time shows the board again
+        if (!SDL_RectEmpty(&state.overlay_back)) {
+            update[count] = state.overlay_back;
+            expand(v, &update[count++]);
+        }
+    }
+    state.overlay_back = (SDL_Rect) {0, 0, 0, 0};
+    if (state.overlay) {
+        draw_overlay(generation, stats, &state.overlay_back);
+        if (!SDL_RectEmpty(&state.overlay_back)) update[count++] = state.overlay_back;
+    }
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+    state.drawn = (struct Drawn) {true, v->level, v->x, v->y, v->width, v->height, v->camera};
+
+    if (full || all) SDL_UpdateWindowSurface(state.window);
+    else if (count) SDL_UpdateWindowSurfaceRects(state.window, update, count);
+}
+
+void step_tiles(void *data, const int ty0, const int ty1) {
+    (void) data;
+    life_step_tiles(&state.grid, &state.next, &state.tiles, ty0, ty1);
+}
+
+void step_grid() {
+    // Apply the rule, 64 cells per word (see life.c). Conway's B3/S23 unless
+    // --rule says otherwise:
+    // 1. Any live cell with 2 or 3 live neighbors survives
+    // 2. Any dead cell with exactly 3 live neighbors becomes alive
+    // 3. All other cells die or stay dead
+    // Only tiles near last generation's changes are looked at. Lenia cells
+    // all move a little every step
+    if (state.lenia) {
+        lenia_step(state.lenia);
+        mark_all();
+    } else if (state.universe) {
+        // The universe hands back what changed within the board
+        if (!universe_step(state.universe)) SDL_Log("Out of memory, cells moving into empty space were lost");
+        universe_store_grid(state.universe, &state.grid, state.tiles.changed);
+        tiles_refresh(&state.tiles, &state.grid);
+    } else {
+        grid_wrap(&state.grid);
+        pool_run(state.pool, step_tiles, NULL, state.tiles.rows);
+        grid_unwrap(&state.grid);
+
+        // Swap updated grid into viewable grid
+        const grid_t tmp = state.grid;
+        state.grid = state.next;
+        state.next = tmp;
+        tiles_swap(&state.tiles);
+    }
+    state.generation++;
+    if (!state.headless) {
+        mips_mark(&state.mips, state.tiles.changed);
+        pipeline_mark(&state.pipeline, state.tiles.changed);
+    }
+    if (state.history) history_record(state.history, &state.grid, state.tiles.changed, state.generation);
+    if (state.checkpoint) checkpoint_mark(state.checkpoint, state.tiles.changed);
+    if (state.cycle && !state.settled) check_settled();
+}
+
+// The board cell under the pointer, as of the events handled so far and
+// wherever the camera is now
+void mouse_cell(int *y, int *x) {
+    *y = (int) SDL_floor(state.camera.y + state.mouse.y / state.camera.zoom);
+    *x = (int) SDL_floor(state.camera.x + state.mouse.x / state.camera.zoom);
+}
+
+void update_grid() {
+    // Stepping writes the tiles it touches into next, which has to stay the
+    // previous generation for the ones it skips, so don't step just to throw
+    // the result away
     if (state.paused) return;
-    for (int y = 0; y < HEIGHT; y++) {
-        memcpy(state.grid[y], new_grid[y], WIDTH * sizeof(int));
+
+    step_grid();
+}
+
+void fast_forward() {
+    if (state.universe) {
+        SDL_Log("Can't fast forward an unbounded board, HashLife would only get the visible part");
+        return;
+    }
+    if (life_topology() != TOPOLOGY_PLANE) {
+        SDL_Log("Can't fast forward a %s, HashLife only runs the plane", topology_name(life_topology()));
+        return;
+    }
+    if (!state.hashlife_rule) {
+        SDL_Log("Can't fast forward, HashLife only runs two state B/S rules");
+        return;
+    }
+    // HashLife sees the board as a window onto an unbounded plane, so
+    // unlike update_grid() cells may leave the board and are dropped
+    if (!hashlife_load_grid(state.hashlife, &state.grid, 0, 0) || !hashlife_step(state.hashlife, state.fast_forward)) {
+        SDL_Log("Out of memory, fast forwarding 2^%d generations was given up and the board left as it was", state.fast_forward);
+        return;
+    }
+    hashlife_store_grid(state.hashlife, &state.grid, 0, 0);
+    state.generation += hashlife_generation(state.hashlife);
+    mark_all();
+}
+
+void random_soup() {
+    // Every soup gets a seed of its own, the same ones again after a restart
+    if (state.lenia) {
+        lenia_soup(state.lenia, soup_next(&state.rng), state.density, 0, state.height, 0, state.width);
+        return;
+    }
+    soup_fill(&state.grid, state.pool, soup_next(&state.rng), state.density, 0, state.height, 0, state.width);
+    mark_all();
+}
+
+// Queues a checkpoint of the board, false if the last one is still being
+// written. The board has to be held
+bool save_checkpoint() {
+    const checkpoint_meta_t meta = {.topology = life_topology(), .generation = state.generation, .rule = state.rule, .rng = state.rng};
+    return checkpoint_save(state.checkpoint, &state.grid, &meta);
+}
+
+// False if the board was left as it was
+bool load_pattern(const char *path) {
+    if (state.lenia) {
+        SDL_Log("Patterns only load onto a Life board, not %s", path);
+        return false;
+    }
+    if (!pattern_load(path, &state.grid)) {
+        SDL_Log("Couldn't load %s: %s", path, SDL_GetError());
+        return false;
     }
+    mark_all();
+    return true;
+}
+
+// Moves the board through its history, pausing it. False if there's no
+// further to go
+bool scrub(const long steps) {
+    if (!state.history) return false;
+    state.paused = true;
+    return history_seek(state.history, &state.grid, &state.tiles, steps, &state.generation);
 }
 
 void spawn_ship() {
-    const int my = state.mouse.y, mx = state.mouse.x;
-    state.grid[my][mx] = 1;
+    int my, mx;
+    mouse_cell(&my, &mx);
+    set_cell(my, mx, 1);
     for (int dy = 1; dy < 4; dy++) {
         for (int dx = 0; dx < 4; dx++) {
-            state.grid[my + dy][mx + dx] = 1;
+            set_cell(my + dy, mx + dx, 1);
         }
     }
 }
 
 void spawn_glider() {
-    const int my = state.mouse.y, mx = state.mouse.x;
-    state.grid[my][mx] =
-    state.grid[my + 1][mx + 1] =
-    state.grid[my + 2][mx - 1] =
-    state.grid[my + 2][mx] =
-    state.grid[my + 2][mx + 1] = 1;
+    int my, mx;
+    mouse_cell(&my, &mx);
+    set_cell(my, mx, 1);
+    set_cell(my + 1, mx + 1, 1);
+    set_cell(my + 2, mx - 1, 1);
+    set_cell(my + 2, mx, 1);
+    set_cell(my + 2, mx + 1, 1);
+}
+
+// Pixels per cell that fit the whole board in the window
+double fit_zoom() {
+    return SDL_min((double) state.window_width / state.width, (double) state.window_height / state.height);
+}
+
+// Keeps the middle of the window on the board
+void clamp_camera() {
+    camera_t *c = &state.camera;
+    const double half_width = state.window_width / c->zoom / 2, half_height = state.window_height / c->zoom / 2;
+    c->x = SDL_clamp(c->x, -half_width, state.width - half_width);
+    c->y = SDL_clamp(c->y, -half_height, state.height - half_height);
+}
+
+// Zooms by `factor`, keeping the cell under pixel (px, py) where it is
+void zoom_camera(const double factor, const int px, const int py) {
+    camera_t *c = &state.camera;
+    const double zoom = SDL_clamp(c->zoom * factor, SDL_min(fit_zoom() / 2, 1), MAX_ZOOM);
+    c->x += px / c->zoom - px / zoom;
+    c->y += py / c->zoom - py / zoom;
+    c->zoom = zoom;
+    clamp_camera();
+}
+
+void pan_camera(const int dx, const int dy) {
+    state.camera.x -= dx / state.camera.zoom;
+    state.camera.y -= dy / state.camera.zoom;
+    clamp_camera();
+}
+
+// The whole board, centered
+void fit_camera() {
+    camera_t *c = &state.camera;
+    c->zoom = fit_zoom();
+    c->x = (state.width - state.window_width / c->zoom) / 2;
+    c->y = (state.height - state.window_height / c->zoom) / 2;
 }
 
-void handle_events() {
+// Waits for the sim thread to finish its batch and tells it not to start
+// the next one
+void hold_board() {
+    SDL_AtomicAdd(&state.edits_waiting, 1);
+    SDL_LockMutex(state.lock);
+    SDL_AtomicAdd(&state.edits_waiting, -1);
+}
+
+// Lets the sim thread go on, starting with publishing what was edited
+void release_board() {
+    state.edited = true;
+    SDL_UnlockMutex(state.lock);
+    SDL_SemPost(state.wake);
+}
+
+// Waits up to `timeout` ms for an event, then handles it and whatever else
+// is queued
+void handle_events(const int timeout) {
     SDL_Event ev;
-    while (SDL_PollEvent(&ev)) {
+    if (!SDL_WaitEventTimeout(&ev, timeout)) return;
+    do {
+        // Later events in the batch may have moved the pointer on, so where
+        // it was goes with each one
+        if (ev.type == SDL_MOUSEMOTION) {
+            state.mouse.x = ev.motion.x;
+            state.mouse.y = ev.motion.y;
+        } else if (ev.type == SDL_MOUSEBUTTONDOWN) {
+            state.mouse.x = ev.button.x;
+            state.mouse.y = ev.button.y;
+        } else if (ev.type == SDL_MOUSEWHEEL) {
+            state.mouse.x = ev.wheel.mouseX;
+            state.mouse.y = ev.wheel.mouseY;
+        }
+        if (ev.type == SDL_QUIT) {
+            state.running = false;
+            continue;
+        }
+        if (ev.type == state.published_event) {
+            SDL_AtomicSet(&state.published_posted, 0);
+            continue;
+        }
+        if (ev.type == SDL_WINDOWEVENT) {
+            const Uint8 e = ev.window.event;
+            if (e == SDL_WINDOWEVENT_EXPOSED || e == SDL_WINDOWEVENT_SIZE_CHANGED || e == SDL_WINDOWEVENT_RESTORED) state.redraw = true;
+            continue;
+        }
+        // The texture may have lost what it held
+        if (ev.type == SDL_RENDER_TARGETS_RESET || ev.type == SDL_RENDER_DEVICE_RESET) {
+            state.drawn.valid = false;
+            state.redraw = true;
+            continue;
+        }
+        // Moving the camera only needs the view captured again
+        if (ev.type == SDL_MOUSEWHEEL || (ev.type == SDL_MOUSEMOTION && ev.motion.state & (SDL_BUTTON_RMASK | SDL_BUTTON_MMASK))) {
+            hold_board();
+            if (ev.type == SDL_MOUSEWHEEL) zoom_camera(SDL_pow(ZOOM_STEP, ev.wheel.preciseY), ev.wheel.mouseX, ev.wheel.mouseY);
+            else pan_camera(ev.motion.xrel, ev.motion.yrel);
+            release_board();
+            continue;
+        }
+        if (ev.type != SDL_MOUSEBUTTONDOWN && ev.type != SDL_KEYDOWN && ev.type != SDL_DROPFILE) continue;
+
+        // Everything below may edit the board
+        hold_board();
+        bool edited = true;
+
         switch (ev.type) {
             default: break;
-            case SDL_QUIT:
-                state.running = false; break;
-
             case SDL_MOUSEBUTTONDOWN:
-                const int my = state.mouse.y, mx = state.mouse.x;
-                state.grid[my][mx] = state.grid[my][mx] == 1 ? 0 : 1; break;
+                if (ev.button.button != SDL_BUTTON_LEFT) {
+                    edited = false;
+                    break;
+                }
+                int my, mx;
+                mouse_cell(&my, &mx);
+                if (state.lenia) {
+                    // A single cell would just fade, drop a kernel's worth
+                    // of soup
+                    const int r = state.lenia->params.radius;
+                    lenia_soup(state.lenia, soup_next(&state.rng), state.density, my - r, my + r, mx - r, mx + r);
+                } else {
+                    set_cell(my, mx, !get_cell(my, mx));
+                }
+                break;
+
+            case SDL_DROPFILE:
+                edited = load_pattern(ev.drop.file);
+                SDL_free(ev.drop.file); break;
 
             case SDL_KEYDOWN:
                 switch (ev.key.keysym.sym) {
-                    default: break;
+                    default:
+                        edited = false; break;
                     case SDLK_SPACE:
-                        state.paused = !state.paused; break;
+                        state.paused = !state.paused;
+                        edited = false; break;
                     case SDLK_RETURN:
                         state.paused = !state.paused;
                         update_grid();
                         state.paused = !state.paused; break;
                     case SDLK_BACKSPACE:
-                        memset(state.grid, 0, sizeof(state.grid)); break;
+                        if (state.universe) universe_clear(state.universe);
+                        if (state.lenia) lenia_clear(state.lenia);
+                        grid_clear(&state.grid);
+                        mark_all(); break;
                     case SDLK_s:
                         spawn_ship(); break;
                     case SDLK_g:
                         spawn_glider(); break;
+                    case SDLK_f:
+                        fast_forward(); break;
+                    case SDLK_r:
+                        random_soup(); break;
+                    case SDLK_i:
+                        state.overlay = !state.overlay;
+                        edited = false; break;
+                    case SDLK_HOME:
+                        fit_camera();
+                        edited = false; break;
+                    case SDLK_LEFT:
+                        scrub(ev.key.keysym.mod & KMOD_SHIFT ? -SCRUB_STEPS : -1); break;
+                    case SDLK_RIGHT:
+                        // Past the newest generation there's nothing to redo
+                        if (!scrub(ev.key.keysym.mod & KMOD_SHIFT ? SCRUB_STEPS : 1)) step_grid();
+                        break;
                 }
         }
+
+        if (!edited) {
+            release_board();
+            continue;
+        }
+        // Edits are history too, scrubbing leaves nothing new to record
+        if (state.history) history_record(state.history, &state.grid, state.tiles.changed, state.generation);
+        if (state.checkpoint) checkpoint_mark(state.checkpoint, state.tiles.changed);
+        mips_mark(&state.mips, state.tiles.changed);
+        pipeline_mark(&state.pipeline, state.tiles.changed);
+        if (state.universe) universe_load_grid(state.universe, &state.grid, state.tiles.changed);
+        if (state.lenia) lenia_refresh(state.lenia);
+        // An edited board gets watched for repeats all over again
+        const uint64_t hash = state.tiles.hash;
+        tiles_refresh(&state.tiles, &state.grid);
+        if (state.cycle && state.tiles.hash != hash) {
+            cycle_reset(state.cycle);
+            state.settled = false;
+        }
+        release_board();
+    } while (SDL_PollEvent(&ev));
+}
+
+// Captures what the camera sees of the board into the pipeline
+void publish() {
+    view_t *v = pipeline_back(&state.pipeline);
+    if (state.lenia) {
+        view_capture_field(v, state.lenia->cells, state.width, state.height, &state.camera, state.window_width, state.window_height);
+        pipeline_publish(&state.pipeline, state.generation, &state.lenia->stats);
+    } else {
+        view_capture(v, &state.grid, &state.mips, &state.camera, state.window_width, state.window_height);
+        pipeline_publish(&state.pipeline, state.generation, &state.tiles.stats);
+    }
+    if (SDL_AtomicCAS(&state.published_posted, 0, 1)) {
+        SDL_Event ev = {.type = state.published_event};
+        if (SDL_PushEvent(&ev) != 1) SDL_AtomicSet(&state.published_posted, 0);
     }
 }
 
-void init() {
-    memset(state.grid, 0, sizeof(state.grid));
-    state.window = SDL_CreateWindow("Game of Life", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH * CELL_SIZE, HEIGHT * CELL_SIZE,SDL_WINDOW_SHOWN);
-    state.renderer = SDL_CreateRenderer(state.window, -1, SDL_RENDERER_ACCELERATED);
+// The sim thread runs a fixed timestep: every time around the simulation
+// is owed gps generations per second elapsed and pays off as many as fit in
+// one frame's time, then publishes the newest one. Generations that don't
+// fit carry over. The render thread never waits for any of this, it just
+// draws whatever was published last
+int sim_main(void *data) {
+    (void) data;
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 batch_ticks = freq / state.fps;
+    const Uint64 checkpoint_ticks = freq * state.checkpoint_every;
+    Uint64 last = SDL_GetPerformanceCounter(), last_checkpoint = last;
+    double owed = 0;
+
+    while (!SDL_AtomicGet(&state.sim_quit)) {
+        SDL_LockMutex(state.lock);
+        const Uint64 now = SDL_GetPerformanceCounter();
+        if (state.paused) owed = 0;
+        else if (state.gps) owed = SDL_min(owed + (double) (now - last) * state.gps / freq, 1 + state.gps * MAX_BACKLOG);
+        last = now;
+
+        bool stepped = false;
+        while (!state.paused && (state.gps == 0 || owed >= 1)) {
+            step_grid();
+            owed -= 1;
+            stepped = true;
+            if (SDL_GetPerformanceCounter() >= now + batch_ticks || SDL_AtomicGet(&state.edits_waiting)) break;
+        }
+        if (stepped || state.edited) {
+            publish();
+            state.edited = false;
+        }
+        // Only diffs and copies the board, the writing happens elsewhere
+        if (state.checkpoint && now - last_checkpoint >= checkpoint_ticks && save_checkpoint()) {
+            last_checkpoint = now;
+        }
+        const bool paused = state.paused;
+        SDL_UnlockMutex(state.lock);
+
+        // Let a queued edit have the lock before the next batch
+        while (SDL_AtomicGet(&state.edits_waiting)) SDL_Delay(0);
+
+        // Sleep until the next generation is due, edits wake us up early
+        if (paused) SDL_SemWait(state.wake);
+        else if (state.gps && owed < 1) SDL_SemWaitTimeout(state.wake, (Uint32) ((1 - owed) * 1000 / state.gps) + 1);
+    }
+    return 0;
+}
+
+int config_value(const int argc, char *argv[], const char *flag, const char *env, const int fallback, const int min) {
+    int value = fallback;
+    const char *str = SDL_getenv(env);
+    if (str) value = SDL_atoi(str);
+    for (int i = 1; i + 1 < argc; i++) {
+        if (SDL_strcmp(argv[i], flag) == 0) value = SDL_atoi(argv[i + 1]);
+    }
+    return value >= min ? value : fallback;
+}
+
+bool config_flag(const int argc, char *argv[], const char *flag, const char *env) {
+    const char *str = SDL_getenv(env);
+    bool value = str && SDL_atoi(str) != 0;
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], flag) == 0) value = true;
+    }
+    return value;
+}
+
+const char *config_string(const int argc, char *argv[], const char *flag, const char *env, const char *fallback) {
+    const char *value = SDL_getenv(env);
+    if (!value) value = fallback;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (SDL_strcmp(argv[i], flag) == 0) value = argv[i + 1];
+    }
+    return value;
+}
+
+bool init(const int argc, char *argv[]) {
+    life_init();
+    state.width = config_value(argc, argv, "--width", "GOLC_WIDTH", WIDTH, 1);
+    state.height = config_value(argc, argv, "--height", "GOLC_HEIGHT", HEIGHT, 1);
+    state.cell_size = config_value(argc, argv, "--cell-size", "GOLC_CELL_SIZE", CELL_SIZE, 1);
+    state.pool = pool_create(config_value(argc, argv, "--threads", "GOLC_THREADS", THREADS, 0));
+    state.fast_forward = config_value(argc, argv, "--fast-forward", "GOLC_FAST_FORWARD", FAST_FORWARD, 0);
+    state.hashlife = hashlife_create(0);
+    state.headless = config_flag(argc, argv, "--headless", "GOLC_HEADLESS");
+    state.generations = config_value(argc, argv, "--generations", "GOLC_GENERATIONS", GENERATIONS, 1);
+    state.gps = config_value(argc, argv, "--gps", "GOLC_GPS", GPS, 0);
+    state.fps = config_value(argc, argv, "--fps", "GOLC_FPS", FPS, 1);
+    state.checkpoint_every = config_value(argc, argv, "--checkpoint-every", "GOLC_CHECKPOINT_EVERY", CHECKPOINT_EVERY, 1);
+    state.rng = (uint64_t) config_value(argc, argv, "--seed", "GOLC_SEED", SEED, 0);
+    state.density = SDL_min(config_value(argc, argv, "--density", "GOLC_DENSITY", SOUP_DENSITY, 0), 100);
+    state.stress_test = config_flag(argc, argv, "--stress-test", "GOLC_STRESS_TEST");
+    state.census = config_value(argc, argv, "--census", "GOLC_CENSUS", 0, 0);
+    if (state.census) state.headless = true;
+    const int history_mb = config_value(argc, argv, "--history-mb", "GOLC_HISTORY_MB", HISTORY_MB, 0);
+    const char *pattern = config_string(argc, argv, "--pattern", "GOLC_PATTERN", NULL);
+    const char *rule = config_string(argc, argv, "--rule", "GOLC_RULE", NULL);
+    state.rule = RULE_CONWAY;
+    if (rule && !rule_parse(&state.rule, rule)) {
+        SDL_Log("Unknown rule %s, running B3/S23", rule);
+    } else if (!rule && pattern) {
+        pattern_rule(pattern, &state.rule);
+    }
+
+    // Lenia runs instead of the rule, on a board its FFT can take
+    const char *lenia = config_string(argc, argv, "--lenia", "GOLC_LENIA", NULL);
+    lenia_params_t lenia_params;
+    if (lenia && !lenia_parse(&lenia_params, lenia)) {
+        SDL_Log("Unknown Lenia parameters %s", lenia);
+        return false;
+    }
+    if (lenia) {
+        const int width = lenia_side(state.width), height = lenia_side(state.height);
+        if (width != state.width || height != state.height) SDL_Log("Lenia needs powers of two, running a %d x %d board", width, height);
+        state.width = width;
+        state.height = height;
+    }
+
+    // A checkpoint to resume from decides the board, rule and topology
+    const char *checkpoint = config_string(argc, argv, "--checkpoint", "GOLC_CHECKPOINT", NULL);
+    if (checkpoint && state.rule.radius) {
+        SDL_Log("Checkpoints can't hold a Larger than Life rule, ignoring --checkpoint %s", checkpoint);
+        checkpoint = NULL;
+    }
+    if (checkpoint && lenia) {
+        SDL_Log("Checkpoints only hold Life boards, ignoring --checkpoint %s", checkpoint);
+        checkpoint = NULL;
+    }
+    checkpoint_meta_t meta;
+    const bool resume = checkpoint && checkpoint_read_meta(checkpoint, &meta);
+    if (checkpoint && !resume) {
+        SDL_RWops *existing = SDL_RWFromFile(checkpoint, "rb");
+        if (existing) {
+            SDL_RWclose(existing);
+            SDL_Log("Not overwriting %s: %s", checkpoint, SDL_GetError());
+            return false;
+        }
+    }
+    if (resume) {
+        state.width = meta.width;
+        state.height = meta.height;
+        state.rule = meta.rule;
+    }
+    life_set_rule(&state.rule);
+    const char *topology_arg = config_string(argc, argv, "--topology", "GOLC_TOPOLOGY", NULL);
+    topology_t topology = TOPOLOGY_PLANE;
+    if (topology_arg && !topology_parse(&topology, topology_arg)) SDL_Log("Unknown topology %s, running the plane", topology_arg);
+    if (resume && topology_arg && topology != meta.topology) {
+        SDL_Log("%s was saved on a %s, ignoring --topology %s", checkpoint, topology_name(meta.topology), topology_arg);
+    }
+    if (resume) topology = meta.topology;
+    bool unbounded = config_flag(argc, argv, "--unbounded", "GOLC_UNBOUNDED");
+    const bool software = config_flag(argc, argv, "--software", "GOLC_SOFTWARE");
+    if (resume && unbounded && topology != TOPOLOGY_PLANE) {
+        SDL_Log("%s was saved on a %s, ignoring --unbounded", checkpoint, topology_name(topology));
+        unbounded = false;
+    }
+    // Larger than Life reaches further than the halo joined edges or the
+    // universe's tiles give it
+    if (state.rule.radius && topology != TOPOLOGY_PLANE) {
+        SDL_Log("Larger than Life only runs on the plane, ignoring --topology %s", topology_arg);
+        topology = TOPOLOGY_PLANE;
+    }
+    if (state.rule.radius && unbounded) {
+        SDL_Log("Larger than Life only runs on a bounded board, ignoring --unbounded");
+        unbounded = false;
+    }
+    // The FFT wraps around whatever the topology says
+    if (lenia && topology_arg && topology != TOPOLOGY_TORUS) {
+        SDL_Log("Lenia only runs on the torus, ignoring --topology %s", topology_arg);
+    }
+    if (lenia && unbounded) {
+        SDL_Log("Lenia only runs on a bounded board, ignoring --unbounded");
+        unbounded = false;
+    }
+    if (lenia) topology = TOPOLOGY_TORUS;
+    if (unbounded && topology != TOPOLOGY_PLANE) {
+        SDL_Log("An unbounded board has no edges to join, ignoring --topology %s", topology_arg);
+        topology = TOPOLOGY_PLANE;
+    }
+    if (state.census && (state.rule.states != 2 || state.rule.radius || lenia || topology != TOPOLOGY_PLANE)) {
+        SDL_Log("The census only runs two state B/S rules on the plane");
+        return false;
+    }
+    life_set_topology(topology);
+
+    if (!state.pool) {
+        SDL_Log("Couldn't start the worker pool: %s", SDL_GetError());
+        return false;
+    }
+    if (!state.hashlife) {
+        SDL_Log("Out of memory for the HashLife engine");
+        return false;
+    }
+    state.hashlife_rule = !lenia && hashlife_set_rule(state.hashlife, &state.rule);
+    if (lenia && !(state.lenia = lenia_create(&lenia_params, state.width, state.height, state.pool))) {
+        SDL_Log("Couldn't make the Lenia board: %s", SDL_GetError());
+        return false;
+    }
+    const int planes = rule_planes(&state.rule);
+    if (!grid_create_planes(&state.grid, state.width, state.height, planes)
+            || !grid_create_planes(&state.next, state.width, state.height, planes)
+            || !tiles_create(&state.tiles, &state.grid)) {
+        SDL_Log("Out of memory for a %d x %d board", state.width, state.height);
+        return false;
+    }
+    if (resume) {
+        if (!checkpoint_restore(checkpoint, &state.grid, &meta)) {
+            SDL_Log("Couldn't restore %s: %s", checkpoint, SDL_GetError());
+            return false;
+        }
+        state.generation = meta.generation;
+        state.rng = meta.rng;
+        SDL_Log("Resumed generation %llu from %s", (unsigned long long) state.generation, checkpoint);
+    } else if (state.stress_test) {
+        const Uint64 start = SDL_GetPerformanceCounter();
+        random_soup();
+        const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+        const double bytes = (double) state.grid.words * sizeof(uint64_t) * state.height * state.grid.planes;
+        SDL_Log("Filled a %d x %d soup in %.1f ms, %.2f GB/s", state.width, state.height, seconds * 1e3, bytes / seconds / 1e9);
+    } else if (pattern) {
+        load_pattern(pattern);
+    } else if (state.lenia) {
+        // An empty one would stay that way
+        random_soup();
+    }
+    if (state.lenia) lenia_refresh(state.lenia);
+    if (checkpoint && !(state.checkpoint = checkpoint_create(checkpoint, &state.grid))) {
+        SDL_Log("Couldn't start checkpointing: %s", SDL_GetError());
+        return false;
+    }
+    if (unbounded) {
+        if (!(state.universe = universe_create(planes))) {
+            SDL_Log("Out of memory for the unbounded universe");
+            return false;
+        }
+        universe_load_grid(state.universe, &state.grid, NULL);
+    }
+
     state.running = true;
     state.paused = true;
+    state.overlay = true;
+    if (state.headless) return true;
+
+    state.window_width = SDL_min(state.width, SDL_max(MAX_WINDOW_WIDTH / state.cell_size, 1)) * state.cell_size;
+    state.window_height = SDL_min(state.height, SDL_max(MAX_WINDOW_HEIGHT / state.cell_size, 1)) * state.cell_size;
+    state.camera = (camera_t) {0, 0, state.cell_size};
+    char name[64], title[96];
+    rule_format(&state.rule, name, sizeof(name));
+    if (state.lenia) {
+        lenia_format(&state.lenia->params, name, sizeof(name));
+        SDL_snprintf(title, sizeof(title), "Lenia %s", name);
+    } else if (topology == TOPOLOGY_PLANE) SDL_snprintf(title, sizeof(title), "Game of Life %s", name);
+    else SDL_snprintf(title, sizeof(title), "Game of Life %s (%s)", name, topology_name(topology));
+    init_palette();
+    state.window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, state.window_width, state.window_height,SDL_WINDOW_SHOWN);
+    if (!software) state.renderer = SDL_CreateRenderer(state.window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_RendererInfo info;
+    if (state.renderer && SDL_GetRendererInfo(state.renderer, &info) == 0 && info.flags & SDL_RENDERER_SOFTWARE) {
+        SDL_DestroyRenderer(state.renderer);
+        state.renderer = NULL;
+    }
+    // Rendering in software only adds a queue of commands to what drawing
+    // into the window surface does, which needs 32 bit pixels though
+    if (!state.renderer) {
+        state.surface = SDL_GetWindowSurface(state.window);
+        state.sample_x = SDL_malloc((size_t) state.window_width * sizeof(int));
+        state.sample_y = SDL_malloc((size_t) state.window_height * sizeof(int));
+        if (!state.sample_x || !state.sample_y) {
+            SDL_Log("Out of memory for the window surface");
+            return false;
+        }
+        if (state.surface && state.surface->format->BytesPerPixel != 4) {
+            SDL_DestroyWindowSurface(state.window);
+            state.surface = NULL;
+        }
+        if (!state.surface && !(state.renderer = SDL_CreateRenderer(state.window, -1, SDL_RENDERER_SOFTWARE))) {
+            SDL_Log("Couldn't draw into the window: %s", SDL_GetError());
+            return false;
+        }
+    }
+    if (state.renderer) {
+        // Cells have to stay crisp squares when the texture is scaled up
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+        state.texture = SDL_CreateTexture(state.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, state.window_width + 2, state.window_height + 2);
+    }
+
+    if (!pipeline_create(&state.pipeline, state.window_width, state.window_height, state.tiles.cols, state.tiles.rows) || !mips_create(&state.mips, &state.grid)) {
+        SDL_Log("Out of memory for the render pipeline");
+        return false;
+    }
+    // The pointer may start out over the window without moving
+    SDL_GetMouseState(&state.mouse.x, &state.mouse.y);
+    state.lock = SDL_CreateMutex();
+    state.wake = SDL_CreateSemaphore(0);
+    state.edited = true;
+    state.redraw = true;
+    if ((state.published_event = SDL_RegisterEvents(1)) == (Uint32) -1) {
+        SDL_Log("Out of SDL user events");
+        return false;
+    }
+    const size_t history_budget = (size_t) history_mb << 20;
+    if (history_mb && !state.universe && !state.lenia && history_budget < history_min_budget(&state.grid)) {
+        SDL_Log("A %d x %d board doesn't fit in a %d MB history, rewinding is off", state.width, state.height, history_mb);
+    } else if (history_mb && !state.universe && !state.lenia && !(state.history = history_create(&state.grid, state.generation, history_budget, HISTORY_KEYFRAME))) {
+        SDL_Log("Out of memory for the history");
+        return false;
+    }
+    if (!state.universe && !state.lenia && !(state.cycle = cycle_create(MAX_PERIOD))) {
+        SDL_Log("Out of memory for the cycle detector");
+        return false;
+    }
+    tiles_track(&state.tiles, &state.grid, state.cycle ? TILES_HASH | TILES_STATS : TILES_STATS);
+    if (!state.lock || !state.wake || !(state.sim = SDL_CreateThread(sim_main, "golc sim", NULL))) {
+        SDL_Log("Couldn't start the sim thread: %s", SDL_GetError());
+        return false;
+    }
+    return true;
 }
 
 void deinit() {
     // Clean up
-    SDL_DestroyRenderer(state.renderer);
-    SDL_DestroyWindow(state.window);
+    if (state.sim) {
+        SDL_AtomicSet(&state.sim_quit, 1);
+        SDL_SemPost(state.wake);
+        SDL_WaitThread(state.sim, NULL);
+    }
+    if (state.checkpoint) {
+        checkpoint_flush(state.checkpoint);
+        save_checkpoint();
+        checkpoint_destroy(state.checkpoint);
+    }
+    history_destroy(state.history);
+    universe_destroy(state.universe);
+    lenia_destroy(state.lenia);
+    cycle_destroy(state.cycle);
+    if (state.lock) SDL_DestroyMutex(state.lock);
+    if (state.wake) SDL_DestroySemaphore(state.wake);
+    pipeline_destroy(&state.pipeline);
+    mips_destroy(&state.mips);
+    if (state.texture) SDL_DestroyTexture(state.texture);
+    if (state.renderer) SDL_DestroyRenderer(state.renderer);
+    SDL_free(state.sample_x);
+    SDL_free(state.sample_y);
+    if (state.window) SDL_DestroyWindow(state.window);
+    grid_destroy(&state.grid);
+    grid_destroy(&state.next);
+    tiles_destroy(&state.tiles);
+    pool_destroy(state.pool);
+    hashlife_destroy(state.hashlife);
     SDL_Quit();
 }
 
-int main() {
-    init();
+void run_headless() {
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const Uint64 checkpoint_ticks = SDL_GetPerformanceFrequency() * state.checkpoint_every;
+    Uint64 last_checkpoint = start;
+    for (int g = 0; g < state.generations; g++) {
+        step_grid();
+        if (state.checkpoint && SDL_GetPerformanceCounter() - last_checkpoint >= checkpoint_ticks && save_checkpoint()) {
+            last_checkpoint = SDL_GetPerformanceCounter();
+        }
+    }
+    const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+
+    char rule[64];
+    rule_format(&state.rule, rule, sizeof(rule));
+    const char *rule_kernel = life_rule_kernel_name(), *kernel = life_kernel_name();
+    if (state.lenia) {
+        lenia_format(&state.lenia->params, rule, sizeof(rule));
+        rule_kernel = "lenia";
+        kernel = fft_kernel_name(state.lenia->fft);
+    }
+    printf("{\"width\":%d,\"height\":%d,\"generations\":%d,\"generation\":%llu,\"rule\":\"%s\",\"topology\":\"%s\",\"rule_kernel\":\"%s\",\"kernel\":\"%s\",\"threads\":%d,"
+           "\"seconds\":%.6f,\"gens_per_sec\":%.1f,\"cells_per_sec\":%.4g}\n",
+           state.width, state.height, state.generations, (unsigned long long) state.generation, rule, topology_name(life_topology()), rule_kernel, kernel, pool_threads(state.pool),
+           seconds, state.generations / seconds, (double) state.width * state.height * state.generations / seconds);
+}
+
+bool run_census() {
+    census_t *census = census_create();
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const bool ran = census && census_run(census, state.pool, state.rng, 0, state.census);
+    const double seconds = (double) (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+    census_object_t *objects = NULL;
+    size_t count = 0;
+    if (!ran || !census_objects(census, &objects, &count)) {
+        SDL_Log("Out of memory for the census");
+        census_destroy(census);
+        return false;
+    }
+
+    char rule[64];
+    rule_format(&state.rule, rule, sizeof(rule));
+    printf("{\"census\":%llu,\"seed\":%llu,\"rule\":\"%s\",\"threads\":%d,\"seconds\":%.6f,\"soups_per_sec\":%.1f,"
+           "\"unsettled\":%llu,\"objects\":{",
+           (unsigned long long) census_soups(census), (unsigned long long) state.rng, rule, pool_threads(state.pool),
+           seconds, census_soups(census) / seconds, (unsigned long long) census_unsettled(census));
+    for (size_t i = 0; i < count; i++) {
+        printf("%s\"%s\":%llu", i ? "," : "", objects[i].code, (unsigned long long) objects[i].count);
+    }
+    printf("}}\n");
+    SDL_free(objects);
+    census_destroy(census);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!init(argc, argv)) return 1;
+    if (state.census) {
+        const bool ran = run_census();
+        deinit();
+        return ran ? 0 : 1;
+    }
+    if (state.headless) {
+        run_headless();
+        deinit();
+        return 0;
+    }
+
+    // Stepping happens on the sim thread, this one only handles input and
+    // draws the newest published generation, at most fps times per second.
+    // Nothing published and nothing to redraw (paused, say) it just sleeps
+    // until the next event
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 frame_ticks = freq / state.fps;
+    Uint64 next_frame = SDL_GetPerformanceCounter();
+
     while (state.running) {
-        handle_events();
+        handle_events(IDLE_WAIT);
+        if (!pipeline_fresh(&state.pipeline) && !state.redraw) continue;
+        const bool redraw = state.redraw;
+        state.redraw = false;
+
+        const view_t *view = pipeline_latest(&state.pipeline);
+        const SDL_Rect *damage;
+        const int damaged = pipeline_latest_damage(&state.pipeline, &damage);
+        const uint64_t generation = pipeline_latest_generation(&state.pipeline);
+        const life_stats_t *stats = pipeline_latest_stats(&state.pipeline);
+        if (state.surface) {
+            draw_surface(view, damage, damaged, redraw, generation, stats);
+        } else {
+            render_grid(view, damage, damaged);
+            if (state.overlay) render_overlay(generation, stats);
+            SDL_RenderPresent(state.renderer);
+        }
 
-        render_grid();
-        SDL_RenderPresent(state.renderer);
-        SDL_Delay(200);
-        update_grid();
+        // Sleep until the next frame is due, skipping any we're late for
+        const Uint64 now = SDL_GetPerformanceCounter();
+        next_frame += frame_ticks;
+        if (next_frame < now) next_frame = now;
+        else if (next_frame - now >= freq / 1000) SDL_Delay((Uint32) ((next_frame - now) * 1000 / freq));
     }
     deinit();
     return 0;
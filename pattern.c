@@ -0,0 +1,477 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "pattern.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PATTERN_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define READ_BUFFER (64 * 1024)
+// Regular files are mapped this much at a time, a multiple of the page size
+#define MAP_WINDOW ((uint64_t) 16 << 20)
+// Header lines are cut off past this
+#define LINE_CHARS 256
+// Highest Macrocell level whose coordinates still fit an int64_t
+#define MAX_LEVEL 62
+#define MAX_RUN ((int64_t) 1 << 48)
+
+#define END (-1)
+
+typedef struct Reader {
+    const uint8_t *pos, *end;
+    SDL_RWops *rw;
+    bool own_rw;
+    bool failed;
+    int fd;                 // mapped file, or -1
+    uint8_t *map;
+    size_t map_size;
+    uint64_t offset, size;  // of the next window, of the file
+    uint8_t buf[READ_BUFFER];
+} reader_t;
+
+static reader_t *reader_new(void) {
+    reader_t *r = SDL_calloc(1, sizeof(*r));
+    if (!r) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    r->fd = -1;
+    return r;
+}
+
+static reader_t *reader_open(const char *path) {
+    reader_t *r = reader_new();
+    if (!r) return NULL;
+#ifdef PATTERN_MMAP
+    struct stat st;
+    const int fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        r->fd = fd;
+        r->size = (uint64_t) st.st_size;
+        return r;
+    }
+    if (fd >= 0) close(fd);
+#endif
+    r->rw = SDL_RWFromFile(path, "rb");
+    r->own_rw = true;
+    if (!r->rw) {
+        SDL_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+static void reader_close(reader_t *r) {
+#ifdef PATTERN_MMAP
+    if (r->map) munmap(r->map, r->map_size);
+    if (r->fd >= 0) close(r->fd);
+#endif
+    if (r->own_rw) SDL_RWclose(r->rw);
+    SDL_free(r);
+}
+
+// Moves on to the next window or buffer full, false at the end
+static bool refill(reader_t *r) {
+#ifdef PATTERN_MMAP
+    if (r->fd >= 0) {
+        if (r->map) munmap(r->map, r->map_size);
+        r->map = NULL;
+        if (r->offset >= r->size) return false;
+
+        r->map_size = (size_t) SDL_min(r->size - r->offset, MAP_WINDOW);
+        void *map = mmap(NULL, r->map_size, PROT_READ, MAP_PRIVATE, r->fd, (off_t) r->offset);
+        if (map == MAP_FAILED) {
+            r->failed = true;
+            return false;
+        }
+        madvise(map, r->map_size, MADV_SEQUENTIAL);
+        r->map = map;
+        r->offset += r->map_size;
+        r->pos = r->map;
+        r->end = r->map + r->map_size;
+        return true;
+    }
+#endif
+    const size_t n = SDL_RWread(r->rw, r->buf, 1, sizeof(r->buf));
+    if (n == 0) return false;
+    r->pos = r->buf;
+    r->end = r->buf + n;
+    return true;
+}
+
+static inline int peek(reader_t *r) {
+    if (r->pos == r->end && !refill(r)) return END;
+    return *r->pos;
+}
+
+static inline int next(reader_t *r) {
+    const int c = peek(r);
+    if (c != END) r->pos++;
+    return c;
+}
+
+static void skip_line(reader_t *r) {
+    for (int c = next(r); c != END && c != '\n'; c = next(r)) {}
+}
+
+static void skip_blank(reader_t *r) {
+    for (int c = peek(r); c == ' ' || c == '\t' || c == '\r' || c == '\n'; c = peek(r)) r->pos++;
+}
+
+// Reads the rest of the line, keeping the first size - 1 characters
+static void read_line(reader_t *r, char *line, const size_t size) {
+    size_t n = 0;
+    for (int c = next(r); c != END && c != '\n'; c = next(r)) {
+        if (c != '\r' && n + 1 < size) line[n++] = (char) c;
+    }
+    line[n] = '\0';
+}
+
+static bool read_uint(reader_t *r, uint64_t *value) {
+    for (int c = peek(r); c == ' ' || c == '\t'; c = peek(r)) r->pos++;
+    int c = peek(r);
+    if (c < '0' || c > '9') return false;
+    *value = 0;
+    for (; c >= '0' && c <= '9'; c = peek(r)) {
+        if (*value < UINT32_MAX) *value = *value * 10 + (uint64_t) (c - '0');
+        r->pos++;
+    }
+    return true;
+}
+
+// Copies s into out minus surrounding blanks
+static void trim(char *out, const size_t size, const char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    size_t n = SDL_strlcpy(out, s, size);
+    n = SDL_min(n, size - 1);
+    while (n > 0 && (out[n - 1] == ' ' || out[n - 1] == '\t')) out[--n] = '\0';
+}
+
+typedef struct Header {
+    bool macrocell;
+    bool sized;             // an RLE "x = " line was read
+    char rule[LINE_CHARS];  // empty if the file names none
+    int64_t width, height;  // RLE bounding box, 0 if not given
+} header_t;
+
+// "x = 3, y = 3, rule = B3/S23", only the rule may contain commas
+static void parse_size_line(const char *line, header_t *h) {
+    const char *s = line;
+    while (*s) {
+        while (*s == ' ' || *s == ',') s++;
+        const char *key = s;
+        while (*s && *s != '=') s++;
+        if (!*s) return;
+        s++;
+        if (key[0] == 'r') {
+            trim(h->rule, sizeof(h->rule), s);
+            // Drop bounded grid suffixes like ":T100,100"
+            char *colon = SDL_strchr(h->rule, ':');
+            if (colon) *colon = '\0';
+            return;
+        }
+        if (key[0] == 'x') h->width = SDL_strtoll(s, NULL, 10);
+        if (key[0] == 'y') h->height = SDL_strtoll(s, NULL, 10);
+        while (*s && *s != ',') s++;
+    }
+}
+
+// Leaves r at the first line of cells
+static void read_header(reader_t *r, header_t *h) {
+    char line[LINE_CHARS];
+    memset(h, 0, sizeof(*h));
+    for (;;) {
+        skip_blank(r);
+        switch (peek(r)) {
+            default:
+                return;
+            case '[': // "[M2] (golly 4.2)"
+                h->macrocell = true;
+                skip_line(r);
+                break;
+            case '#':
+                read_line(r, line, sizeof(line));
+                // "#R rule" in Macrocell files, "#r rule" in old RLE ones
+                if (line[1] == 'R' || line[1] == 'r') trim(h->rule, sizeof(h->rule), line + 2);
+                break;
+            case 'x':
+                if (h->macrocell) return;
+                read_line(r, line, sizeof(line));
+                parse_size_line(line, h);
+                h->sized = true;
+                return;
+        }
+    }
+}
+
+static void set_bits(uint64_t *row, const int x0, const int x1) {
+    const int w0 = x0 / 64, w1 = (x1 - 1) / 64;
+    const uint64_t first = ~UINT64_C(0) << (x0 % 64), last = ~UINT64_C(0) >> (63 - (x1 - 1) % 64);
+    if (w0 == w1) {
+        row[w0] |= first & last;
+        return;
+    }
+    row[w0] |= first;
+    for (int w = w0 + 1; w < w1; w++) row[w] = ~UINT64_C(0);
+    row[w1] |= last;
+}
+
+// Sets cells [x, x + n) of row y to state s, clipped to the grid
+static void fill(grid_t *g, const int64_t y, const int64_t x, const int64_t n, const int s) {
+    if (s == 0 || y < 0 || y >= g->height) return;
+    const int64_t x0 = SDL_max(x, 0), x1 = SDL_min(x + n, g->width);
+    if (x0 >= x1) return;
+
+    if (s == 1) {
+        set_bits(grid_row(g, (int) y), (int) x0, (int) x1);
+        return;
+    }
+    // Dying states, if the grid's rule has that many
+    const int dying = s - 1;
+    if (dying >> (g->planes - 1)) return;
+    for (int p = 1; p < g->planes; p++) {
+        if (dying >> (p - 1) & 1) set_bits(grid_plane_row(g, p, (int) y), (int) x0, (int) x1);
+    }
+}
+
+static bool load_rle(reader_t *r, const header_t *h, grid_t *g) {
+    const int64_t y0 = (g->height - h->height) / 2, x0 = (g->width - h->width) / 2;
+    int64_t y = y0, x = x0, count = 0;
+    int prefix = 0;
+    uint64_t *row = y >= 0 && y < g->height ? grid_row(g, (int) y) : NULL;
+
+    // Decodes straight off the buffer or mapped window, the reader only
+    // hears about it to refill
+    for (; r->pos < r->end || refill(r); ) {
+        const uint8_t *p = r->pos, *end = r->end;
+        while (p < end) {
+            const int c = *p++;
+            if (c >= '0' && c <= '9') {
+                count = SDL_min(count * 10 + (c - '0'), MAX_RUN);
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+
+            const int64_t n = count ? count : 1;
+            count = 0;
+            if (c == 'b' || c == '.') {
+                x += n;
+            } else if (c == 'o') {
+                if (row && x < g->width && x + n > 0) {
+                    set_bits(row, (int) SDL_max(x, 0), (int) SDL_min(x + n, g->width));
+                }
+                x += n;
+            } else if (c == '$') {
+                y += n;
+                x = x0;
+                row = y >= 0 && y < g->height ? grid_row(g, (int) y) : NULL;
+            } else if (c == '!') {
+                r->pos = p;
+                return true;
+            } else if (c == '#') {
+                r->pos = p;
+                skip_line(r);
+                p = r->pos;
+                end = r->end;
+            } else if (c >= 'p' && c <= 'y') {
+                // Multi-state: pA is 25, yX is 255, the run count comes first
+                prefix = (c - 'p' + 1) * 24;
+                count = n;
+            } else if ((c >= 'A' && c <= 'X') || (c >= 'a' && c <= 'z')) {
+                fill(g, y, x, n, c >= 'A' && c <= 'X' ? prefix + c - 'A' + 1 : 1);
+                x += n;
+                prefix = 0;
+            } else {
+                SDL_SetError("Unexpected '%c' in RLE pattern", c);
+                return false;
+            }
+        }
+        r->pos = p;
+    }
+    return true;
+}
+
+typedef struct MacrocellNode {
+    union {
+        uint32_t child[4];  // nw, ne, sw, se: node numbers, or states at level 1
+        uint64_t bits;      // 8x8 leaf, bit 8 * y + x
+    };
+    int8_t level;
+    bool leaf;
+} mc_node_t;
+
+typedef struct Macrocell {
+    mc_node_t *nodes;       // node n (from 1, 0 is empty space) is nodes[n - 1]
+    uint32_t count, capacity;
+} mc_t;
+
+static mc_node_t *mc_push(mc_t *mc) {
+    if (mc->count == mc->capacity) {
+        if (mc->capacity >= UINT32_MAX / 2) return NULL;
+        const uint32_t capacity = mc->capacity ? mc->capacity * 2 : 1024;
+        mc_node_t *nodes = SDL_realloc(mc->nodes, capacity * sizeof(mc_node_t));
+        if (!nodes) return NULL;
+        mc->nodes = nodes;
+        mc->capacity = capacity;
+    }
+    mc_node_t *n = &mc->nodes[mc->count++];
+    memset(n, 0, sizeof(*n));
+    return n;
+}
+
+// "$.*$..*$***$" rows from the top, '.' dead, '*' alive, trailing dead
+// cells and rows left out
+static bool read_leaf(reader_t *r, mc_node_t *n) {
+    int y = 0, x = 0;
+    n->level = 3;
+    n->leaf = true;
+    for (int c = next(r); c != END && c != '\n'; c = next(r)) {
+        if (c == '$') {
+            y++;
+            x = 0;
+        } else if (c == '.' || c == '*') {
+            if (x >= 8 || y >= 8) return false;
+            if (c == '*') n->bits |= UINT64_C(1) << (8 * y + x);
+            x++;
+        } else if (c != '\r' && c != ' ') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "level nw ne sw se", children are earlier nodes one level down
+static bool read_node(reader_t *r, const mc_t *mc, mc_node_t *n) {
+    uint64_t level, child;
+    if (!read_uint(r, &level) || level < 1 || level > MAX_LEVEL) return false;
+    n->level = (int8_t) level;
+    for (int i = 0; i < 4; i++) {
+        if (!read_uint(r, &child)) return false;
+        if (level == 1) {
+            if (child >= RULE_MAX_STATES) return false;
+        } else if (child > mc->count - 1 || (child && mc->nodes[child - 1].level != (int8_t) (level - 1))) {
+            return false;
+        }
+        n->child[i] = (uint32_t) child;
+    }
+    skip_line(r);
+    return true;
+}
+
+static void draw(const mc_t *mc, grid_t *g, const uint32_t index, const int64_t y, const int64_t x) {
+    if (!index) return;
+    const mc_node_t *n = &mc->nodes[index - 1];
+    const int64_t size = (int64_t) 1 << n->level, half = size / 2;
+    if (y >= g->height || x >= g->width || y + size <= 0 || x + size <= 0) return;
+
+    if (n->leaf) {
+        for (int i = 0; i < 64; i++) {
+            if (n->bits >> i & 1) fill(g, y + i / 8, x + i % 8, 1, 1);
+        }
+    } else if (n->level == 1) {
+        for (int i = 0; i < 4; i++) {
+            fill(g, y + i / 2, x + i % 2, 1, (int) n->child[i]);
+        }
+    } else {
+        draw(mc, g, n->child[0], y, x);
+        draw(mc, g, n->child[1], y, x + half);
+        draw(mc, g, n->child[2], y + half, x);
+        draw(mc, g, n->child[3], y + half, x + half);
+    }
+}
+
+static bool load_macrocell(reader_t *r, grid_t *g) {
+    mc_t mc = {0};
+    bool ok = true;
+    for (skip_blank(r); ok && peek(r) != END; skip_blank(r)) {
+        const int c = peek(r);
+        if (c == '#') {
+            skip_line(r);
+            continue;
+        }
+        mc_node_t *n = mc_push(&mc);
+        if (!n) {
+            SDL_OutOfMemory();
+            ok = false;
+        } else if (!(c == '.' || c == '*' || c == '$' ? read_leaf(r, n) : read_node(r, &mc, n))) {
+            SDL_SetError("Bad Macrocell node %u", mc.count);
+            ok = false;
+        }
+    }
+
+    if (ok && !mc.count) {
+        SDL_SetError("Macrocell pattern without nodes");
+        ok = false;
+    }
+    // The last node is the root, centered on the grid
+    if (ok) {
+        const int64_t half = ((int64_t) 1 << mc.nodes[mc.count - 1].level) / 2;
+        draw(&mc, g, mc.count, g->height / 2 - half, g->width / 2 - half);
+    }
+    SDL_free(mc.nodes);
+    return ok;
+}
+
+static bool load(reader_t *r, grid_t *g) {
+    header_t h;
+    read_header(r, &h);
+    if (!h.macrocell && !h.sized) {
+        SDL_SetError("Not an RLE or Macrocell pattern");
+        return false;
+    }
+
+    // Decodes into a scratch grid and only swaps it in once the whole file
+    // went through, so a bad one leaves the board as it was
+    grid_t scratch;
+    if (!grid_create_planes(&scratch, g->width, g->height, g->planes)) {
+        SDL_OutOfMemory();
+        return false;
+    }
+    bool ok = h.macrocell ? load_macrocell(r, &scratch) : load_rle(r, &h, &scratch);
+    if (ok && r->failed) {
+        SDL_SetError("Couldn't map the pattern file");
+        ok = false;
+    }
+    if (ok) {
+        const grid_t tmp = *g;
+        *g = scratch;
+        scratch = tmp;
+    }
+    grid_destroy(&scratch);
+    return ok;
+}
+
+bool pattern_rule(const char *path, rule_t *rule) {
+    reader_t *r = reader_open(path);
+    if (!r) return false;
+    header_t h;
+    read_header(r, &h);
+    reader_close(r);
+    if (!h.rule[0]) return false;
+    if (!rule_parse(rule, h.rule)) {
+        SDL_SetError("Unknown rule %s", h.rule);
+        return false;
+    }
+    return true;
+}
+
+bool pattern_load(const char *path, grid_t *g) {
+    reader_t *r = reader_open(path);
+    if (!r) return false;
+    const bool ok = load(r, g);
+    reader_close(r);
+    return ok;
+}
+
+bool pattern_load_rw(SDL_RWops *rw, grid_t *g) {
+    reader_t *r = reader_new();
+    if (!r) return false;
+    r->rw = rw;
+    const bool ok = load(r, g);
+    reader_close(r);
+    return ok;
+}
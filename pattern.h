@@ -0,0 +1,32 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include "SDL2/SDL.h"
+#include "life.h"
+#include "rule.h"
+
+// Pattern files: RLE (.rle) and Golly's Macrocell (.mc), told apart by
+// their first line.
+//
+// Files are streamed, never read whole: regular files are mapped a window
+// at a time, anything else goes through an SDL_RWops and a small buffer.
+// Runs of live cells are decoded straight into the grid a word at a time.
+// Macrocell files only keep their node table (a few words per line) so
+// the quadtree can be drawn once the root is known.
+//
+// RLE patterns are centered on the grid, Macrocell ones keep their cell
+// coordinates with (0, 0) at the center of the grid. Cells that don't fit
+// are dropped. Multi-state files set the dying states of Generations grids.
+// Errors are reported through SDL_GetError().
+
+// Reads just the rule the file names, false if it names none.
+bool pattern_rule(const char *path, rule_t *rule);
+
+// Replaces the cells of g with the pattern, leaves g alone if the file
+// can't be read or isn't a pattern.
+bool pattern_load(const char *path, grid_t *g);
+// Same for any stream, which is left open.
+bool pattern_load_rw(SDL_RWops *rw, grid_t *g);
+
+#endif
@@ -0,0 +1,152 @@
+#include <string.h>
+#include "pipeline.h"
+
+bool pipeline_create(pipeline_t *p, const int width, const int height, const int cols, const int rows) {
+    memset(p, 0, sizeof(*p));
+    for (int i = 0; i < 3; i++) {
+        if (!view_create(&p->slots[i], width, height)) {
+            pipeline_destroy(p);
+            return false;
+        }
+        p->damaged[i] = -1;
+    }
+    p->cols = cols;
+    p->rows = rows;
+    p->marked = SDL_calloc((size_t) cols * rows, 1);
+    p->unseen = SDL_malloc((size_t) cols * rows);
+    if (!p->marked || !p->unseen) {
+        pipeline_destroy(p);
+        return false;
+    }
+    // Nothing's been drawn yet
+    memset(p->unseen, 1, (size_t) cols * rows);
+    p->back = 0;
+    p->front = 1;
+    SDL_AtomicSet(&p->middle, 2);
+    return true;
+}
+
+void pipeline_destroy(pipeline_t *p) {
+    for (int i = 0; i < 3; i++) {
+        view_destroy(&p->slots[i]);
+    }
+    SDL_free(p->marked);
+    SDL_free(p->unseen);
+    p->marked = p->unseen = NULL;
+}
+
+void pipeline_mark(pipeline_t *p, const uint8_t *changed) {
+    const size_t n = (size_t) p->cols * p->rows;
+    for (size_t i = 0; i < n; i++) p->marked[i] |= changed[i];
+}
+
+view_t *pipeline_back(pipeline_t *p) {
+    return &p->slots[p->back];
+}
+
+// Samples [*first, *last) of level `level` covering cells [from, to), from
+// the view's first sample `at` and clipped to its `size`
+static void to_samples(const int from, const int to, const int level, const int at, const int size, int *first, int *last) {
+    *first = SDL_max((from >> level) - at, 0);
+    *last = SDL_min(((to + (1 << level) - 1) >> level) - at, size);
+}
+
+// Gathers the damaged tiles into slot's rectangles: runs along each tile
+// row, each grown down over the same run in the rows below
+static void damage(pipeline_t *p, const int slot) {
+    const view_t *v = &p->slots[slot];
+    SDL_Rect *rects = p->damage[slot];
+    int count = 0, done = 0;   // the rectangles from `done` on reach the last row
+    for (int ty = 0; ty < p->rows; ty++) {
+        const int row_start = count;
+        const uint8_t *marked = p->marked + (size_t) ty * p->cols, *unseen = p->unseen + (size_t) ty * p->cols;
+        for (int tx = 0; tx < p->cols; tx++) {
+            if (!(marked[tx] | unseen[tx])) continue;
+            const int run = tx;
+            while (tx < p->cols && (marked[tx] | unseen[tx])) tx++;
+
+            int r = done;
+            while (r < row_start && !(rects[r].x == run && rects[r].w == tx - run && rects[r].y + rects[r].h == ty)) r++;
+            if (r < row_start) {
+                rects[r].h++;
+                continue;
+            }
+            if (count == PIPELINE_RECTS) {
+                p->damaged[slot] = -1;
+                return;
+            }
+            rects[count++] = (SDL_Rect) {run, ty, tx - run, 1};
+        }
+        // The ones that didn't reach this row are done growing
+        for (int r = done; r < row_start; r++) {
+            if (rects[r].y + rects[r].h == ty + 1) continue;
+            const SDL_Rect finished = rects[r];
+            rects[r] = rects[done];
+            rects[done++] = finished;
+        }
+    }
+
+    // Tiles to samples, leaving out what the view doesn't show
+    int kept = 0;
+    for (int r = 0; r < count; r++) {
+        int x0, x1, y0, y1;
+        to_samples(rects[r].x * 64, (rects[r].x + rects[r].w) * 64, v->level, v->x, v->width, &x0, &x1);
+        to_samples(rects[r].y * LIFE_TILE_ROWS, (rects[r].y + rects[r].h) * LIFE_TILE_ROWS, v->level, v->y, v->height, &y0, &y1);
+        if (x0 < x1 && y0 < y1) rects[kept++] = (SDL_Rect) {x0, y0, x1 - x0, y1 - y0};
+    }
+    p->damaged[slot] = kept;
+}
+
+// Puts `slot` in the middle and returns whatever was there
+static int exchange(pipeline_t *p, const int slot) {
+    int old;
+    do {
+        old = SDL_AtomicGet(&p->middle);
+    } while (!SDL_AtomicCAS(&p->middle, old, slot));
+    return old;
+}
+
+void pipeline_publish(pipeline_t *p, const uint64_t generation, const life_stats_t *stats) {
+    p->generations[p->back] = generation;
+    p->stats[p->back] = *stats;
+    // The reader takes this slot having either the one published last or
+    // whatever it took before that, the damage has to cover both
+    damage(p, p->back);
+    const int old = exchange(p, p->back | PIPELINE_FRESH);
+    p->back = old & ~PIPELINE_FRESH;
+
+    // If the last publish went unread its changes are still unseen,
+    // otherwise the reader has caught up to it
+    const size_t n = (size_t) p->cols * p->rows;
+    if (old & PIPELINE_FRESH) {
+        for (size_t i = 0; i < n; i++) p->unseen[i] |= p->marked[i];
+    } else {
+        memcpy(p->unseen, p->marked, n);
+    }
+    memset(p->marked, 0, n);
+}
+
+const view_t *pipeline_latest(pipeline_t *p) {
+    p->taken = SDL_AtomicGet(&p->middle) & PIPELINE_FRESH;
+    if (p->taken) {
+        p->front = exchange(p, p->front) & ~PIPELINE_FRESH;
+    }
+    return &p->slots[p->front];
+}
+
+bool pipeline_fresh(pipeline_t *p) {
+    return SDL_AtomicGet(&p->middle) & PIPELINE_FRESH;
+}
+
+uint64_t pipeline_latest_generation(const pipeline_t *p) {
+    return p->generations[p->front];
+}
+
+const life_stats_t *pipeline_latest_stats(const pipeline_t *p) {
+    return &p->stats[p->front];
+}
+
+int pipeline_latest_damage(const pipeline_t *p, const SDL_Rect **rects) {
+    *rects = p->damage[p->front];
+    return p->taken ? p->damaged[p->front] : 0;
+}
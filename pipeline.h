@@ -0,0 +1,68 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "SDL2/SDL.h"
+#include "life.h"
+#include "view.h"
+
+// Lock-free triple buffer handing what the window shows of finished
+// generations from the sim thread to the render thread.
+//
+// The writer always owns one slot and the reader another. The third sits
+// in `middle` together with a fresh bit, and either side swaps its own slot
+// for it with a compare-and-swap, so neither ever waits on the other: the
+// writer overwrites an unread generation with a newer one, the reader keeps
+// drawing what it has until something newer shows up.
+//
+// Every slot also carries its damage: the samples that may differ from the
+// slot the reader had before taking it, as rectangles, so the reader only
+// has to redraw those. The writer marks the tiles every generation changed
+// and turns them into rectangles when it publishes. A publish the reader
+// never took has its damage carried into the ones after it.
+
+#define PIPELINE_FRESH 4
+#define PIPELINE_RECTS 64  // per slot, past that all of it is damaged
+
+typedef struct Pipeline {
+    view_t slots[3];
+    uint64_t generations[3];    // each slot's generation and stats
+    life_stats_t stats[3];
+    SDL_atomic_t middle;    // slot index | PIPELINE_FRESH if not yet read
+    int back;               // the writer's slot
+    int front;              // the reader's slot
+    bool taken;             // the last pipeline_latest() took a new slot
+
+    // Laid out like tiles_t, cols x rows
+    int cols, rows;
+    uint8_t *marked;        // changed since the last publish
+    uint8_t *unseen;        // changed in publishes the reader may not have taken
+    SDL_Rect damage[3][PIPELINE_RECTS]; // in samples from the slot's first one
+    int damaged[3];         // rectangles in each slot's damage, -1 for all
+} pipeline_t;
+
+// Slots fit a width x height pixel window onto a board of cols x rows
+// tiles.
+bool pipeline_create(pipeline_t *p, int width, int height, int cols, int rows);
+void pipeline_destroy(pipeline_t *p);
+
+// Writer side: mark what changes, fill pipeline_back() and publish it.
+// `changed` is laid out like tiles_t.
+void pipeline_mark(pipeline_t *p, const uint8_t *changed);
+view_t *pipeline_back(pipeline_t *p);
+void pipeline_publish(pipeline_t *p, uint64_t generation, const life_stats_t *stats);
+
+// Reader side: the newest published slot, or the one it had if nothing new
+// was published. Stays valid until the next call.
+const view_t *pipeline_latest(pipeline_t *p);
+// Whether something was published since the last pipeline_latest().
+bool pipeline_fresh(pipeline_t *p);
+// What the slot pipeline_latest() returned was published with.
+uint64_t pipeline_latest_generation(const pipeline_t *p);
+const life_stats_t *pipeline_latest_stats(const pipeline_t *p);
+// What changed since the slot the reader had before the last
+// pipeline_latest(): the number of rectangles put in *rects, none if it kept
+// the same one, -1 if all of it.
+int pipeline_latest_damage(const pipeline_t *p, const SDL_Rect **rects);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include "SDL2/SDL.h"
+#include "pool.h"
+
+// Chunks per thread, more than one so a slow stripe doesn't stall the barrier
+#define POOL_CHUNKS_PER_THREAD 4
+
+struct Pool {
+    int threads;
+    SDL_Thread **workers;
+    SDL_sem *start;     // posted once per worker per run
+    SDL_sem *done;      // posted by the last worker to finish a run
+    SDL_atomic_t pending;
+    SDL_atomic_t next;  // next chunk to hand out
+    bool quit;
+
+    // The current run, written before `start` is posted
+    pool_job_t job;
+    void *data;
+    int count, chunk;
+};
+
+static void run_chunks(pool_t *pool) {
+    for (;;) {
+        const int begin = SDL_AtomicAdd(&pool->next, 1) * pool->chunk;
+        if (begin >= pool->count) return;
+        pool->job(pool->data, begin, SDL_min(begin + pool->chunk, pool->count));
+    }
+}
+
+static int worker_main(void *arg) {
+    pool_t *pool = arg;
+    for (;;) {
+        SDL_SemWait(pool->start);
+        if (pool->quit) return 0;
+        run_chunks(pool);
+        // SDL_AtomicAdd returns the old value, 1 means we were the last one
+        if (SDL_AtomicAdd(&pool->pending, -1) == 1) SDL_SemPost(pool->done);
+    }
+}
+
+pool_t *pool_create(int threads) {
+    if (threads <= 0) threads = SDL_GetCPUCount();
+    pool_t *pool = SDL_calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+
+    pool->threads = SDL_max(threads, 1);
+    pool->start = SDL_CreateSemaphore(0);
+    pool->done = SDL_CreateSemaphore(0);
+    pool->workers = SDL_calloc(pool->threads, sizeof(*pool->workers));
+    if (!pool->start || !pool->done || !pool->workers) {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 1; i < pool->threads; i++) {
+        pool->workers[i] = SDL_CreateThread(worker_main, "golc worker", pool);
+        if (!pool->workers[i]) {
+            // Carry on with whatever we got
+            pool->threads = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void pool_destroy(pool_t *pool) {
+    if (!pool) return;
+    pool->quit = true;
+    for (int i = 1; i < pool->threads; i++) {
+        SDL_SemPost(pool->start);
+    }
+    for (int i = 1; i < pool->threads; i++) {
+        SDL_WaitThread(pool->workers[i], NULL);
+    }
+    if (pool->start) SDL_DestroySemaphore(pool->start);
+    if (pool->done) SDL_DestroySemaphore(pool->done);
+    SDL_free(pool->workers);
+    SDL_free(pool);
+}
+
+int pool_threads(const pool_t *pool) {
+    return pool->threads;
+}
+
+void pool_run(pool_t *pool, const pool_job_t job, void *data, const int count) {
+    if (count <= 0) return;
+    if (pool->threads == 1 || count == 1) {
+        job(data, 0, count);
+        return;
+    }
+
+    const int chunks = pool->threads * POOL_CHUNKS_PER_THREAD;
+    pool->job = job;
+    pool->data = data;
+    pool->count = count;
+    pool->chunk = (count + chunks - 1) / chunks;
+    SDL_AtomicSet(&pool->next, 0);
+    SDL_AtomicSet(&pool->pending, pool->threads - 1);
+    for (int i = 1; i < pool->threads; i++) {
+        SDL_SemPost(pool->start);
+    }
+
+    run_chunks(pool);
+    SDL_SemWait(pool->done);
+}
@@ -0,0 +1,24 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Persistent worker pool.
+//
+// Threads are spawned once and park on a semaphore between runs, so handing
+// out a generation costs a couple of semaphore posts instead of a thread
+// spawn. pool_run() is a barrier: it returns once every chunk is done.
+
+typedef struct Pool pool_t;
+
+// Called with a half open range [begin, end) of the work handed to pool_run().
+typedef void (*pool_job_t)(void *data, int begin, int end);
+
+// threads <= 0 means one per cpu. The calling thread counts as one of them.
+pool_t *pool_create(int threads);
+void pool_destroy(pool_t *pool);
+int pool_threads(const pool_t *pool);
+
+// Splits [0, count) into chunks, runs them on every thread including the
+// caller and blocks until all of them finished.
+void pool_run(pool_t *pool, pool_job_t job, void *data, int count);
+
+#endif
@@ -0,0 +1,175 @@
+#include "SDL2/SDL.h"
+#include "rule.h"
+
+static const struct {
+    const char *name, *rule;
+} named[] = {
+    {"life", "B3/S23"},
+    {"conway", "B3/S23"},
+    {"highlife", "B36/S23"},
+    {"daynight", "B3678/S34678"},
+    {"seeds", "B2/S"},
+    {"lwod", "B3/S012345678"}, // life without death
+    {"maze", "B3/S12345"},
+    {"brian", "B2/S/C3"},      // Brian's Brain
+    {"starwars", "B2/S345/C4"},
+};
+
+static const char neighborhoods[] = "MNC";
+
+// A decimal number of up to `max`, false if there's none or it's bigger
+static bool parse_number(const char **s, const int max, int *out) {
+    if (**s < '0' || **s > '9') return false;
+    int n = 0;
+    for (; **s >= '0' && **s <= '9'; (*s)++) {
+        n = n * 10 + (**s - '0');
+        if (n > max) return false;
+    }
+    *out = n;
+    return true;
+}
+
+// "a..b", or just "a" for a..a
+static bool parse_range(const char **s, int *min, int *max) {
+    const int most = (2 * RULE_MAX_RADIUS + 1) * (2 * RULE_MAX_RADIUS + 1);
+    if (!parse_number(s, most, min)) return false;
+    *max = *min;
+    if (SDL_strncmp(*s, "..", 2) != 0) return true;
+    *s += 2;
+    return parse_number(s, most, max) && *max >= *min;
+}
+
+// Radius 1 on the square is just a B/S rule, which has faster kernels
+static void to_life_like(rule_t *r) {
+    if (r->radius != 1 || r->neighborhood != NEIGHBORHOOD_MOORE || r->birth_max > 8 || r->survive_max - r->middle > 8) return;
+    for (int n = r->birth_min; n <= r->birth_max; n++) r->birth |= (uint16_t) (1 << n);
+    // Survival counts the live cell itself
+    for (int n = SDL_max(r->survive_min - r->middle, 0); n <= r->survive_max - r->middle; n++) r->survive |= (uint16_t) (1 << n);
+    r->radius = 0;
+}
+
+// Comma separated lettered fields in any order: R, S and B needed, C
+// (states, 0 means 2), M and N optional
+static bool parse_larger(rule_t *rule, const char *s) {
+    rule_t r = {.states = 2, .neighborhood = NEIGHBORHOOD_MOORE};
+    bool seen[26] = {false};
+    for (;; s++) {
+        const int letter = SDL_toupper((unsigned char) *s);
+        if (letter < 'A' || letter > 'Z' || seen[letter - 'A']) return false;
+        seen[letter - 'A'] = true;
+        s++;
+        int value;
+        switch (letter) {
+            default: return false;
+            case 'R':
+                if (!parse_number(&s, RULE_MAX_RADIUS, &r.radius) || r.radius < 1) return false;
+                break;
+            case 'C':
+                if (!parse_number(&s, RULE_MAX_STATES, &value) || value == 1) return false;
+                r.states = SDL_max(value, 2);
+                break;
+            case 'M':
+                if (!parse_number(&s, 1, &value)) return false;
+                r.middle = value;
+                break;
+            case 'S':
+                if (!parse_range(&s, &r.survive_min, &r.survive_max)) return false;
+                break;
+            case 'B':
+                if (!parse_range(&s, &r.birth_min, &r.birth_max)) return false;
+                break;
+            case 'N': {
+                const char *n = *s ? SDL_strchr(neighborhoods, SDL_toupper((unsigned char) *s)) : NULL;
+                if (!n) return false;
+                r.neighborhood = (neighborhood_t) (n - neighborhoods);
+                s++;
+                break;
+            }
+        }
+        if (*s == '\0') break;
+        if (*s != ',') return false;
+    }
+    if (!seen['R' - 'A'] || !seen['S' - 'A'] || !seen['B' - 'A'] || r.birth_min == 0) return false;
+    to_life_like(&r);
+    *rule = r;
+    return true;
+}
+
+// Fields in the order S/B notation lists them
+enum { SURVIVE, BIRTH, STATES, FIELDS };
+
+bool rule_parse(rule_t *rule, const char *str) {
+    for (size_t i = 0; i < SDL_arraysize(named); i++) {
+        if (SDL_strcasecmp(str, named[i].name) == 0) str = named[i].rule;
+    }
+    if (SDL_toupper((unsigned char) str[0]) == 'R') return parse_larger(rule, str);
+
+    rule_t r = {.states = 2};
+    bool seen[FIELDS] = {false};
+    int field = 0;
+    const char *s = str;
+    if (!*s) return false;
+
+    for (;; field++) {
+        // Lettered fields go by their letter, bare ones by position
+        int kind = field;
+        switch (SDL_toupper((unsigned char) *s)) {
+            default: break;
+            case 'S': kind = SURVIVE; s++; break;
+            case 'B': kind = BIRTH; s++; break;
+            case 'C':
+            case 'G': kind = STATES; s++; break;
+        }
+        if (kind >= FIELDS || seen[kind]) return false;
+        seen[kind] = true;
+
+        if (kind == STATES) {
+            int states = 0;
+            if (*s < '0' || *s > '9') return false;
+            for (; *s >= '0' && *s <= '9'; s++) {
+                states = states * 10 + (*s - '0');
+                if (states > RULE_MAX_STATES) return false;
+            }
+            if (states < 2) return false;
+            r.states = states;
+        } else {
+            uint16_t *counts = kind == BIRTH ? &r.birth : &r.survive;
+            for (; *s >= '0' && *s <= '8'; s++) {
+                *counts |= (uint16_t) (1 << (*s - '0'));
+            }
+        }
+
+        if (*s == '\0') break;
+        if (*s++ != '/') return false;
+    }
+
+    if (r.birth & 1) return false;
+    *rule = r;
+    return true;
+}
+
+void rule_format(const rule_t *rule, char *buf, const size_t size) {
+    if (rule->radius) {
+        SDL_snprintf(buf, size, "R%d,C%d,M%d,S%d..%d,B%d..%d,N%c", rule->radius, rule->states > 2 ? rule->states : 0,
+                     rule->middle, rule->survive_min, rule->survive_max, rule->birth_min, rule->birth_max,
+                     neighborhoods[rule->neighborhood]);
+        return;
+    }
+    char b[10], s[10];
+    int nb = 0, ns = 0;
+    for (int n = 0; n <= 8; n++) {
+        if (rule->birth >> n & 1) b[nb++] = (char) ('0' + n);
+        if (rule->survive >> n & 1) s[ns++] = (char) ('0' + n);
+    }
+    b[nb] = s[ns] = '\0';
+
+    if (rule->states > 2) SDL_snprintf(buf, size, "B%s/S%s/C%d", b, s, rule->states);
+    else SDL_snprintf(buf, size, "B%s/S%s", b, s);
+}
+
+int rule_planes(const rule_t *rule) {
+    // Dying cells count up from 1 (state 2) to states - 2 (the last state)
+    int planes = 1;
+    for (int top = rule->states - 2; top > 0; top >>= 1) planes++;
+    return planes;
+}
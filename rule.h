@@ -0,0 +1,61 @@
+#ifndef RULE_H
+#define RULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Outer totalistic rules on the Moore neighborhood.
+//
+// A rule is the set of live neighbor counts a dead cell is born on and the
+// set a live cell survives on. Generations rules add dying states: a live
+// cell that doesn't survive ages through states 2 .. states - 1 and then
+// dies. Dying cells don't count as neighbors and can't be born.
+//
+// Larger than Life rules count the neighbors within a radius of up to
+// RULE_MAX_RADIUS instead, in a square, a diamond or a disc, and are born
+// and survive on a range of counts each. They can have dying states too.
+//
+// Rules with B0 aren't supported, on a board that skips quiet tiles empty
+// space would have to flash every generation.
+
+#define RULE_MAX_STATES 256
+// Anything further would reach past the tiles next to a cell's own
+#define RULE_MAX_RADIUS 64
+
+typedef enum Neighborhood {
+    NEIGHBORHOOD_MOORE,         // |dx|, |dy| <= radius
+    NEIGHBORHOOD_VON_NEUMANN,   // |dx| + |dy| <= radius
+    NEIGHBORHOOD_CIRCULAR,      // dx^2 + dy^2 <= radius^2 + radius, within half a cell
+} neighborhood_t;
+
+typedef struct Rule {
+    uint16_t birth, survive; // bit n set: n live neighbors
+    int states;              // 2 for plain life-like rules
+    // Larger than Life if radius is set, 0 for the rules above. The counts
+    // include the cell itself if `middle`
+    int radius;
+    neighborhood_t neighborhood;
+    bool middle;
+    int birth_min, birth_max, survive_min, survive_max;
+} rule_t;
+
+#define RULE_CONWAY ((rule_t) {.birth = 1 << 3, .survive = 1 << 2 | 1 << 3, .states = 2})
+
+// Parses B/S notation ("B36/S23"), the older S/B one ("23/36"),
+// Generations rules in either ("B2/S345/C4", "345/2/4"), a few names like
+// "highlife" or "seeds" and Larger than Life rules the way Golly writes
+// them ("R5,C0,M1,S34..58,B34..45,NM", NN for the diamond and NC for the
+// disc). Larger than Life rules with radius 1 on the square that B/S can
+// say come back as B/S. False if it's none of those.
+bool rule_parse(rule_t *rule, const char *str);
+
+// Writes the canonical B/S form, with /C<states> for Generations rules, or
+// Golly's for Larger than Life ones.
+void rule_format(const rule_t *rule, char *buf, size_t size);
+
+// Bit planes a grid needs per cell: the live one, plus a counter for the
+// dying states of Generations rules.
+int rule_planes(const rule_t *rule);
+
+#endif
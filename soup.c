@@ -0,0 +1,84 @@
+#include "SDL2/SDL.h"
+#include "soup.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SOUP_X86_SIMD 1
+#endif
+
+// Words of a row made at once
+#define SOUP_RUN 64
+
+typedef struct Fill fill_t;
+typedef void (*soup_words_t)(const fill_t *f, int y, int word, int count, uint64_t *out);
+
+struct Fill {
+    grid_t *g;
+    uint64_t seed;
+    soup_words_t words;
+    uint32_t density;   // out of 2^SOUP_BITS, 0 or all of it handled apart
+    int low;            // its lowest set bit, the words below would be ANDed into nothing
+    int y0, x0, x1;
+};
+
+// Defines name(f, y, word, count, out), making words [word, word +
+// count) of the soup in row y. All of them take in a random word per
+// density bit before the next bit, the hashes don't depend on each other
+// that way and vectorize
+#define SOUP_WORDS(name, attr)                                              \
+attr static void name(const fill_t *f, const int y, const int word, const int count, uint64_t *out) { \
+    const uint64_t n = ((uint64_t) y << 32 | (uint32_t) word) * SOUP_BITS;  \
+    const uint64_t fill = f->density >> SOUP_BITS ? ~UINT64_C(0) : 0;       \
+    for (int k = 0; k < count; k++) out[k] = fill;                          \
+    if (fill) return;                                                       \
+    for (int i = f->low; i < SOUP_BITS; i++) {                              \
+        if (f->density >> i & 1) {                                          \
+            for (int k = 0; k < count; k++) out[k] |= soup_hash(f->seed, n + (uint64_t) k * SOUP_BITS + i); \
+        } else {                                                            \
+            for (int k = 0; k < count; k++) out[k] &= soup_hash(f->seed, n + (uint64_t) k * SOUP_BITS + i); \
+        }                                                                   \
+    }                                                                       \
+}
+
+SOUP_WORDS(soup_words_scalar, )
+#ifdef SOUP_X86_SIMD
+SOUP_WORDS(soup_words_avx2, __attribute__((target("avx2"))))
+#endif
+
+static void fill_rows(void *data, const int begin, const int end) {
+    const fill_t *f = data;
+    const grid_t *g = f->g;
+    const int first = f->x0 / 64, last = (f->x1 - 1) / 64;
+    uint64_t soup[SOUP_RUN];
+    for (int y = f->y0 + begin; y < f->y0 + end; y++) {
+        uint64_t *row = grid_row(g, y);
+        for (int run = first; run <= last; run += SOUP_RUN) {
+            const int count = SDL_min(SOUP_RUN, last + 1 - run);
+            f->words(f, y, run, count, soup);
+            for (int word = run; word < run + count; word++) {
+                // Only the part of the word inside [x0, x1)
+                uint64_t mask = ~UINT64_C(0);
+                if (word == first) mask &= ~UINT64_C(0) << (f->x0 % 64);
+                if (word == last && f->x1 % 64) mask &= (UINT64_C(1) << (f->x1 % 64)) - 1;
+                row[word] = (row[word] & ~mask) | (soup[word - run] & mask);
+                for (int p = 1; p < g->planes; p++) grid_plane_row(g, p, y)[word] &= ~mask;
+            }
+        }
+    }
+}
+
+void soup_fill(grid_t *g, pool_t *pool, const uint64_t seed, const int percent, int y0, int y1, int x0, int x1) {
+    y0 = SDL_max(y0, 0);
+    x0 = SDL_max(x0, 0);
+    y1 = SDL_min(y1, g->height);
+    x1 = SDL_min(x1, g->width);
+    if (y0 >= y1 || x0 >= x1) return;
+
+    const int clamped = SDL_clamp(percent, 0, 100);
+    fill_t f = {g, seed, soup_words_scalar, (uint32_t) ((clamped << SOUP_BITS) + 50) / 100, 0, y0, x0, x1};
+#ifdef SOUP_X86_SIMD
+    if (SDL_HasAVX2()) f.words = soup_words_avx2;
+#endif
+    while (f.low < SOUP_BITS && !(f.density >> f.low & 1)) f.low++;
+    if (pool) pool_run(pool, fill_rows, &f, y1 - y0);
+    else fill_rows(&f, 0, y1 - y0);
+}
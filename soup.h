@@ -0,0 +1,46 @@
+#ifndef SOUP_H
+#define SOUP_H
+
+#include <stdint.h>
+#include "life.h"
+#include "pool.h"
+
+// Random soup, a word of 64 cells at a time.
+//
+// The random bits are counter based: every word is a hash of the seed and
+// where the word is on the board, not the next draw from some shared
+// state. That makes a soup the same no matter how many threads filled it,
+// in what order or how the region was cut up, and lets each thread start
+// anywhere without skipping ahead.
+//
+// A cell's density is taken to SOUP_BITS bits. Going from the lowest set
+// bit of it up, a one ORs in a fresh random word and a zero ANDs one in,
+// which halves what's set so far and adds a half for the ones. That leaves
+// every bit set with the density exactly, for at most SOUP_BITS hashes per
+// 64 cells, a single one at 50%.
+
+#define SOUP_BITS 10
+
+// SplitMix64 at position n of the stream seeded with `seed`. Everything
+// random on a board comes from this
+static inline uint64_t soup_hash(const uint64_t seed, const uint64_t n) {
+    uint64_t z = seed + (n + 1) * UINT64_C(0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+// The next number of the stream *state is at, for seeds that only need to
+// differ from each other
+static inline uint64_t soup_next(uint64_t *state) {
+    const uint64_t z = soup_hash(*state, 0);
+    *state += UINT64_C(0x9E3779B97F4A7C15);
+    return z;
+}
+
+// Fills cells [x0, x1) of rows [y0, y1) of g with soup, each one alive with
+// `percent` percent probability, dying states are cleared. pool may be
+// NULL to fill on the calling thread only. The region is clipped to g.
+void soup_fill(grid_t *g, pool_t *pool, uint64_t seed, int percent, int y0, int y1, int x0, int x1);
+
+#endif
@@ -0,0 +1,474 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "universe.h"
+
+#define CHUNK 64            // cells a side, a chunk row is a word
+#define SLAB_CHUNKS 64
+#define MAP_MIN 64
+#define RUN 32              // chunks stepped side by side at most
+
+// Neighbors in reading order, the opposite of i is 7 - i
+static const int near_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const int near_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+typedef struct Slab slab_t;
+
+typedef struct Chunk {
+    int64_t cy, cx;
+    struct Chunk *near[8];  // NULL where there's no chunk
+    slab_t *slab;
+    struct Chunk *free_next;
+    size_t index;           // in the universe's list
+    int cur;                // which half of cells is the current generation
+    bool changed;           // by the last step or an edit
+    bool wake;              // step it next time even if nothing nearby changed
+    bool stepped, differs;  // during a step
+    uint64_t cells[];       // two generations of planes x CHUNK rows
+} chunk_t;
+
+struct Slab {
+    slab_t *prev, *next;    // among the slabs with free chunks
+    chunk_t *free;
+    int used;
+};
+
+struct Universe {
+    int planes;
+    size_t chunk_bytes, slab_bytes;
+    uint64_t generation;
+
+    // Every chunk, in no particular order
+    chunk_t **list;
+    size_t count, list_capacity;
+
+    // Open addressed with linear probing, capacity a power of two
+    chunk_t **map;
+    size_t map_capacity;
+
+    slab_t *partial;        // slabs with free chunks
+    // An empty slab kept so a chunk coming and going doesn't free and
+    // allocate one
+    slab_t *spare;
+    size_t slabs;
+
+    // Chunks the last step changed, by coordinates since they may be gone
+    int64_t (*touched)[2];
+    size_t touched_count, touched_capacity;
+
+    // A run of chunks with their neighbors' edges around it, and its next
+    // generation
+    grid_t window, out;
+};
+
+static uint64_t *chunk_rows(const universe_t *u, const chunk_t *c, const int half, const int plane) {
+    return (uint64_t *) c->cells + ((size_t) half * u->planes + plane) * CHUNK;
+}
+
+static uint64_t *current(const universe_t *u, const chunk_t *c, const int plane) {
+    return chunk_rows(u, c, c->cur, plane);
+}
+
+// Floor division, chunks left of and above the origin have negative
+// coordinates
+static int64_t chunk_of(const int64_t v) {
+    return v >= 0 ? v / CHUNK : -((-v - 1) / CHUNK) - 1;
+}
+
+static size_t map_slot(const universe_t *u, const int64_t cy, const int64_t cx) {
+    uint64_t z = (uint64_t) cy * UINT64_C(0x9E3779B97F4A7C15) ^ (uint64_t) cx;
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return (size_t) (z ^ (z >> 31)) & (u->map_capacity - 1);
+}
+
+static chunk_t *find(const universe_t *u, const int64_t cy, const int64_t cx) {
+    for (size_t i = map_slot(u, cy, cx);; i = (i + 1) & (u->map_capacity - 1)) {
+        chunk_t *c = u->map[i];
+        if (!c || (c->cy == cy && c->cx == cx)) return c;
+    }
+}
+
+static void map_put(chunk_t **map, const universe_t *u, chunk_t *c) {
+    size_t i = map_slot(u, c->cy, c->cx);
+    while (map[i]) i = (i + 1) & (u->map_capacity - 1);
+    map[i] = c;
+}
+
+static bool map_resize(universe_t *u, const size_t capacity) {
+    chunk_t **map = SDL_calloc(capacity, sizeof(*map));
+    if (!map) return false;
+    u->map_capacity = capacity;
+    for (size_t i = 0; i < u->count; i++) map_put(map, u, u->list[i]);
+    SDL_free(u->map);
+    u->map = map;
+    return true;
+}
+
+// Backward shift deletion, so probes never need tombstones
+static void map_remove(universe_t *u, const chunk_t *c) {
+    const size_t mask = u->map_capacity - 1;
+    size_t hole = map_slot(u, c->cy, c->cx);
+    while (u->map[hole] != c) hole = (hole + 1) & mask;
+    for (size_t i = (hole + 1) & mask; u->map[i]; i = (i + 1) & mask) {
+        const size_t home = map_slot(u, u->map[i]->cy, u->map[i]->cx);
+        // Move it into the hole unless its home lies between the two
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            u->map[hole] = u->map[i];
+            hole = i;
+        }
+    }
+    u->map[hole] = NULL;
+}
+
+static void slab_unlink(universe_t *u, slab_t *s) {
+    if (s->prev) s->prev->next = s->next;
+    else u->partial = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->prev = s->next = NULL;
+}
+
+static void slab_link(universe_t *u, slab_t *s) {
+    s->prev = NULL;
+    s->next = u->partial;
+    if (u->partial) u->partial->prev = s;
+    u->partial = s;
+}
+
+static chunk_t *chunk_alloc(universe_t *u) {
+    if (!u->partial) {
+        slab_t *s = u->spare;
+        u->spare = NULL;
+        if (!s) {
+            if (!(s = SDL_malloc(u->slab_bytes))) return NULL;
+            u->slabs++;
+            memset(s, 0, sizeof(*s));
+            // Chunks follow the header, each starting on a cache line
+            uint8_t *first = (uint8_t *) s + (sizeof(*s) + 63) / 64 * 64;
+            for (int i = SLAB_CHUNKS - 1; i >= 0; i--) {
+                chunk_t *c = (chunk_t *) (first + (size_t) i * u->chunk_bytes);
+                c->slab = s;
+                c->free_next = s->free;
+                s->free = c;
+            }
+        }
+        slab_link(u, s);
+    }
+    slab_t *s = u->partial;
+    chunk_t *c = s->free;
+    s->free = c->free_next;
+    if (!s->free) slab_unlink(u, s);
+    s->used++;
+    return c;
+}
+
+static void chunk_release(universe_t *u, chunk_t *c) {
+    slab_t *s = c->slab;
+    if (!s->free) slab_link(u, s);
+    c->free_next = s->free;
+    s->free = c;
+    if (--s->used) return;
+    slab_unlink(u, s);
+    if (u->spare) {
+        SDL_free(s);
+        u->slabs--;
+    } else {
+        u->spare = s;
+    }
+}
+
+static chunk_t *chunk_create(universe_t *u, const int64_t cy, const int64_t cx) {
+    if ((u->count + 1) * 2 > u->map_capacity && !map_resize(u, u->map_capacity * 2)) return NULL;
+    if (u->count == u->list_capacity) {
+        const size_t capacity = u->list_capacity ? 2 * u->list_capacity : MAP_MIN;
+        chunk_t **list = SDL_realloc(u->list, capacity * sizeof(*list));
+        if (!list) return NULL;
+        u->list = list;
+        u->list_capacity = capacity;
+    }
+    chunk_t *c = chunk_alloc(u);
+    if (!c) return NULL;
+    slab_t *s = c->slab;
+    memset(c, 0, u->chunk_bytes);
+    c->slab = s;
+    c->cy = cy;
+    c->cx = cx;
+    c->wake = true;
+    c->index = u->count;
+    u->list[u->count++] = c;
+    map_put(u->map, u, c);
+    for (int i = 0; i < 8; i++) {
+        chunk_t *n = find(u, cy + near_dy[i], cx + near_dx[i]);
+        c->near[i] = n;
+        if (n) n->near[7 - i] = c;
+    }
+    return c;
+}
+
+static void chunk_destroy(universe_t *u, chunk_t *c) {
+    for (int i = 0; i < 8; i++) {
+        chunk_t *n = c->near[i];
+        if (!n) continue;
+        n->near[7 - i] = NULL;
+        // What it had on its edges just went away
+        if (c->changed) n->wake = true;
+    }
+    map_remove(u, c);
+    u->list[c->index] = u->list[--u->count];
+    u->list[c->index]->index = c->index;
+    chunk_release(u, c);
+    if (u->map_capacity > MAP_MIN && u->count * 8 < u->map_capacity) map_resize(u, u->map_capacity / 2);
+}
+
+universe_t *universe_create(const int planes) {
+    universe_t *u = SDL_calloc(1, sizeof(*u));
+    if (!u) return NULL;
+    u->planes = planes;
+    u->chunk_bytes = (sizeof(chunk_t) + 2 * (size_t) planes * CHUNK * sizeof(uint64_t) + 63) / 64 * 64;
+    u->slab_bytes = (sizeof(slab_t) + 63) / 64 * 64 + SLAB_CHUNKS * u->chunk_bytes;
+    if (!map_resize(u, MAP_MIN)
+            || !grid_create_planes(&u->window, RUN * CHUNK, CHUNK, planes)
+            || !grid_create_planes(&u->out, RUN * CHUNK, CHUNK, planes)) {
+        universe_destroy(u);
+        return NULL;
+    }
+    return u;
+}
+
+void universe_clear(universe_t *u) {
+    while (u->count) chunk_destroy(u, u->list[u->count - 1]);
+    u->touched_count = 0;
+    u->generation = 0;
+}
+
+void universe_destroy(universe_t *u) {
+    if (!u) return;
+    universe_clear(u);
+    SDL_free(u->spare);
+    SDL_free(u->list);
+    SDL_free(u->map);
+    SDL_free(u->touched);
+    grid_destroy(&u->window);
+    grid_destroy(&u->out);
+    SDL_free(u);
+}
+
+int universe_get(const universe_t *u, const int64_t y, const int64_t x) {
+    const chunk_t *c = find(u, chunk_of(y), chunk_of(x));
+    if (!c) return 0;
+    return (int) (current(u, c, 0)[y - c->cy * CHUNK] >> (x - c->cx * CHUNK)) & 1;
+}
+
+void universe_set(universe_t *u, const int64_t y, const int64_t x, const int alive) {
+    chunk_t *c = find(u, chunk_of(y), chunk_of(x));
+    if (!c && (!alive || !(c = chunk_create(u, chunk_of(y), chunk_of(x))))) return;
+    const uint64_t bit = UINT64_C(1) << (x - c->cx * CHUNK);
+    const int64_t row = y - c->cy * CHUNK;
+    uint64_t *word = &current(u, c, 0)[row];
+    *word = alive ? *word | bit : *word & ~bit;
+    for (int p = 1; p < u->planes; p++) current(u, c, p)[row] &= ~bit;
+    c->changed = true;
+}
+
+// Bits of the tile column past the right edge of g
+static uint64_t outside(const grid_t *g, const int tx) {
+    return tx == g->words - 1 && g->width % 64 ? ~((UINT64_C(1) << (g->width % 64)) - 1) : 0;
+}
+
+void universe_load_grid(universe_t *u, const grid_t *g, const uint8_t *changed) {
+    const int rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    for (int ty = 0; ty < rows; ty++) {
+        for (int tx = 0; tx < g->words; tx++) {
+            if (changed && !changed[(size_t) ty * g->words + tx]) continue;
+            const int y0 = ty * CHUNK, y1 = SDL_min(y0 + CHUNK, g->height);
+            chunk_t *c = find(u, ty, tx);
+            if (!c) {
+                bool any = false;
+                for (int p = 0; p < g->planes && !any; p++) {
+                    for (int y = y0; y < y1 && !any; y++) any = grid_plane_row(g, p, y)[tx] != 0;
+                }
+                if (!any || !(c = chunk_create(u, ty, tx))) continue;
+            }
+            const uint64_t keep = outside(g, tx);
+            for (int p = 0; p < g->planes; p++) {
+                uint64_t *to = current(u, c, p);
+                for (int y = y0; y < y1; y++) to[y - y0] = (to[y - y0] & keep) | grid_plane_row(g, p, y)[tx];
+            }
+            c->changed = true;
+        }
+    }
+}
+
+void universe_store_grid(const universe_t *u, grid_t *g, uint8_t *changed) {
+    const int rows = (g->height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+    memset(changed, 0, (size_t) rows * g->words);
+    for (size_t i = 0; i < u->touched_count; i++) {
+        const int64_t ty = u->touched[i][0], tx = u->touched[i][1];
+        if (ty < 0 || ty >= rows || tx < 0 || tx >= g->words) continue;
+        const chunk_t *c = find(u, ty, tx);
+        const int y0 = (int) ty * CHUNK, y1 = SDL_min(y0 + CHUNK, g->height);
+        const uint64_t keep = ~outside(g, (int) tx);
+        for (int p = 0; p < g->planes; p++) {
+            const uint64_t *from = c ? current(u, c, p) : NULL;
+            for (int y = y0; y < y1; y++) grid_plane_row(g, p, y)[tx] = from ? from[y - y0] & keep : 0;
+        }
+        changed[(size_t) ty * g->words + tx] = 1;
+    }
+}
+
+// Makes sure there's a chunk on every side c has live cells on
+static bool make_room(universe_t *u, chunk_t *c) {
+    const uint64_t *rows = current(u, c, 0);
+    uint64_t any = 0;
+    for (int y = 0; y < CHUNK; y++) any |= rows[y];
+    if (!any) return true;
+    const uint64_t top = rows[0], bottom = rows[CHUNK - 1];
+    const bool live[8] = {
+        top & 1, top != 0, top >> 63,
+        any & 1, any >> 63,
+        bottom & 1, bottom != 0, bottom >> 63,
+    };
+    bool ok = true;
+    for (int i = 0; i < 8; i++) {
+        if (live[i] && !c->near[i]) ok &= chunk_create(u, c->cy + near_dy[i], c->cx + near_dx[i]) != NULL;
+    }
+    return ok;
+}
+
+// Steps the n chunks east of `run` (itself included) into their other
+// halves. They go side by side into the window, framed by their
+// neighbors' edges which the kernels read as the halo
+static void step_run(universe_t *u, chunk_t *const *run, const int n) {
+    static const uint64_t none[CHUNK];
+#define EDGE(c, i) ((c)->near[i] ? current(u, (c)->near[i], 0) : none)
+    uint64_t *above = grid_row(&u->window, -1), *below = grid_row(&u->window, CHUNK);
+    above[-1] = EDGE(run[0], 0)[CHUNK - 1];
+    below[-1] = EDGE(run[0], 5)[0];
+    above[n] = EDGE(run[n - 1], 2)[CHUNK - 1];
+    below[n] = EDGE(run[n - 1], 7)[0];
+    const uint64_t *west = EDGE(run[0], 3), *east = EDGE(run[n - 1], 4);
+    for (int y = 0; y < CHUNK; y++) {
+        grid_row(&u->window, y)[-1] = west[y];
+        grid_row(&u->window, y)[n] = east[y];
+    }
+    for (int k = 0; k < n; k++) {
+        above[k] = EDGE(run[k], 1)[CHUNK - 1];
+        below[k] = EDGE(run[k], 6)[0];
+        for (int p = 0; p < u->planes; p++) {
+            const uint64_t *from = current(u, run[k], p);
+            for (int y = 0; y < CHUNK; y++) grid_plane_row(&u->window, p, y)[k] = from[y];
+        }
+    }
+#undef EDGE
+
+    life_step_words(&u->window, &u->out, 0, CHUNK, 0, n);
+    for (int k = 0; k < n; k++) {
+        chunk_t *c = run[k];
+        uint64_t differs = 0;
+        for (int p = 0; p < u->planes; p++) {
+            const uint64_t *was = current(u, c, p);
+            uint64_t *to = chunk_rows(u, c, c->cur ^ 1, p);
+            for (int y = 0; y < CHUNK; y++) {
+                to[y] = grid_plane_row(&u->out, p, y)[k];
+                differs |= to[y] ^ was[y];
+            }
+        }
+        c->differs = differs != 0;
+    }
+}
+
+static bool chunk_empty(const universe_t *u, const chunk_t *c) {
+    for (int p = 0; p < u->planes; p++) {
+        const uint64_t *rows = current(u, c, p);
+        for (int y = 0; y < CHUNK; y++) {
+            if (rows[y]) return false;
+        }
+    }
+    return true;
+}
+
+static void touch(universe_t *u, const chunk_t *c) {
+    if (u->touched_count == u->touched_capacity) {
+        const size_t capacity = u->touched_capacity ? 2 * u->touched_capacity : MAP_MIN;
+        int64_t (*touched)[2] = SDL_realloc(u->touched, capacity * sizeof(*touched));
+        // Out of memory the grid just misses the change
+        if (!touched) return;
+        u->touched = touched;
+        u->touched_capacity = capacity;
+    }
+    u->touched[u->touched_count][0] = c->cy;
+    u->touched[u->touched_count][1] = c->cx;
+    u->touched_count++;
+}
+
+bool universe_step(universe_t *u) {
+    // Chunks made here are empty and have nothing to make room for
+    bool ok = true;
+    const size_t existing = u->count;
+    for (size_t i = 0; i < existing; i++) {
+        if (u->list[i]->changed) ok &= make_room(u, u->list[i]);
+    }
+
+    // Decide what to step before stepping anything, dropping a chunk at the
+    // end wakes its neighbors for the next step
+    for (size_t i = 0; i < u->count; i++) {
+        chunk_t *c = u->list[i];
+        c->stepped = c->changed || c->wake;
+        for (int k = 0; k < 8 && !c->stepped; k++) c->stepped = c->near[k] && c->near[k]->changed;
+        c->wake = false;
+    }
+    // Chunks to step come in runs going east, each starting at one with
+    // nothing to step west of it
+    for (size_t i = 0; i < u->count; i++) {
+        chunk_t *c = u->list[i];
+        if (!c->stepped || (c->near[3] && c->near[3]->stepped)) continue;
+        chunk_t *run[RUN];
+        int n = 0;
+        for (; c && c->stepped; c = c->near[4]) {
+            run[n++] = c;
+            if (n == RUN) {
+                step_run(u, run, n);
+                n = 0;
+            }
+        }
+        if (n) step_run(u, run, n);
+    }
+
+    // Only flip once every chunk has read its neighbors, then drop the
+    // ones that came out empty. Back to front since dropping one moves the
+    // last chunk into its place
+    u->touched_count = 0;
+    for (size_t i = u->count; i-- > 0;) {
+        chunk_t *c = u->list[i];
+        c->changed = c->stepped && c->differs;
+        if (!c->stepped) continue;
+        if (c->differs) {
+            c->cur ^= 1;
+            touch(u, c);
+        }
+        if (chunk_empty(u, c)) chunk_destroy(u, c);
+    }
+    u->generation++;
+    return ok;
+}
+
+uint64_t universe_generation(const universe_t *u) {
+    return u->generation;
+}
+
+uint64_t universe_population(const universe_t *u) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < u->count; i++) {
+        const uint64_t *rows = current(u, u->list[i], 0);
+        for (int y = 0; y < CHUNK; y++) n += (uint64_t) life_popcount(rows[y]);
+    }
+    return n;
+}
+
+size_t universe_chunks(const universe_t *u) {
+    return u->count;
+}
+
+size_t universe_bytes(const universe_t *u) {
+    return u->slabs * u->slab_bytes + u->map_capacity * sizeof(chunk_t *)
+           + u->list_capacity * sizeof(chunk_t *) + u->touched_capacity * sizeof(*u->touched);
+}
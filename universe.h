@@ -0,0 +1,51 @@
+#ifndef UNIVERSE_H
+#define UNIVERSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "life.h"
+
+// Unbounded plane stepped with the regular kernels.
+//
+// The plane is cut into 64x64 chunks laid out like tiles, a word per row,
+// which only exist where something is alive. They are found through an
+// open addressed hash map keyed by chunk coordinates and come out of a slab
+// pool, so creating and dropping them as patterns move costs next to
+// nothing and memory follows the live area, not its bounding box.
+//
+// A step makes room next to every live edge of a chunk that changed, steps
+// every chunk that changed or has a neighbor that did, and drops the ones
+// that came out empty. Grids load and store at the origin, so tile
+// (ty, tx) of a grid is chunk (ty, tx).
+
+typedef struct Universe universe_t;
+
+// Cells carry the dying counter planes of rule_planes() too, the rule is
+// life_set_rule()'s. NULL if out of memory.
+universe_t *universe_create(int planes);
+void universe_destroy(universe_t *u);
+void universe_clear(universe_t *u);
+
+int universe_get(const universe_t *u, int64_t y, int64_t x);
+void universe_set(universe_t *u, int64_t y, int64_t x, int alive);
+
+// Copies the tiles of g flagged in `changed` (laid out like tiles_t, NULL
+// for all of them) into the universe. Cells past the edges of g are kept.
+void universe_load_grid(universe_t *u, const grid_t *g, const uint8_t *changed);
+// Copies the chunks the last step changed into g and flags their tiles in
+// `changed`, clearing every other flag. Cells past the edges of g are left
+// out.
+void universe_store_grid(const universe_t *u, grid_t *g, uint8_t *changed);
+
+// Advances the universe a generation, false if it ran out of memory making
+// room next to a live edge, in which case cells crossing it are lost.
+bool universe_step(universe_t *u);
+
+uint64_t universe_generation(const universe_t *u);
+uint64_t universe_population(const universe_t *u);
+size_t universe_chunks(const universe_t *u);
+// Heap held by chunks, their slabs and the map.
+size_t universe_bytes(const universe_t *u);
+
+#endif
@@ -0,0 +1,231 @@
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "view.h"
+
+#define TILE_LEVEL 6 // a tile is 64x64 cells
+
+bool mips_create(mips_t *m, const grid_t *g) {
+    memset(m, 0, sizeof(*m));
+    if (!(m->sums = SDL_malloc((size_t) g->words * sizeof(uint64_t)))) return false;
+    for (int k = MIPS_BASE; k < MIPS_MAX; k++) {
+        const int size = 1 << k;
+        m->width[k] = (g->width + size - 1) / size;
+        m->height[k] = (g->height + size - 1) / size;
+        const size_t entries = (size_t) m->width[k] * m->height[k];
+        m->level[k] = SDL_calloc(entries, sizeof(uint32_t));
+        if (k >= TILE_LEVEL) m->dirty[k] = SDL_calloc(entries, 1);
+        if (!m->level[k] || (k >= TILE_LEVEL && !m->dirty[k])) {
+            mips_destroy(m);
+            return false;
+        }
+        m->top = k;
+        if (k >= TILE_LEVEL && entries == 1) break;
+    }
+    memset(m->dirty[TILE_LEVEL], 1, (size_t) m->width[TILE_LEVEL] * m->height[TILE_LEVEL]);
+    return true;
+}
+
+void mips_destroy(mips_t *m) {
+    for (int k = 0; k < MIPS_MAX; k++) {
+        SDL_free(m->level[k]);
+        SDL_free(m->dirty[k]);
+    }
+    SDL_free(m->sums);
+    memset(m, 0, sizeof(*m));
+}
+
+void mips_mark(mips_t *m, const uint8_t *changed) {
+    uint8_t *dirty = m->dirty[TILE_LEVEL];
+    const size_t n = (size_t) m->width[TILE_LEVEL] * m->height[TILE_LEVEL];
+    for (size_t i = 0; i < n; i++) dirty[i] |= changed[i];
+}
+
+// Sums up the up to 2x2 entries below entries [x0, x1) of rows [y0, y1) of
+// level k
+static void reduce(mips_t *m, const int k, const int y0, const int y1, const int x0, const int x1) {
+    const int w = m->width[k - 1], h = m->height[k - 1], shift = k > MIPS_EXACT ? 2 : 0;
+    const uint64_t round = (UINT64_C(1) << shift) - 1;
+    for (int y = y0; y < y1; y++) {
+        const uint32_t *a = m->level[k - 1] + (size_t) 2 * y * w;
+        const uint32_t *b = 2 * y + 1 < h ? a + w : NULL;
+        uint32_t *out = m->level[k] + (size_t) y * m->width[k];
+        // The last entry may only have a column below it
+        const int pairs = SDL_min(x1, w / 2);
+        for (int x = x0; x < pairs; x++) {
+            const uint64_t sum = (uint64_t) a[2 * x] + a[2 * x + 1] + (b ? (uint64_t) b[2 * x] + b[2 * x + 1] : 0);
+            out[x] = (uint32_t) ((sum + round) >> shift);
+        }
+        for (int x = SDL_max(x0, pairs); x < x1; x++) {
+            const uint64_t sum = (uint64_t) a[2 * x] + (b ? b[2 * x] : 0);
+            out[x] = (uint32_t) ((sum + round) >> shift);
+        }
+    }
+}
+
+// How full a block of `full` cells with `count` live ones is, 0 only if it's
+// empty so a lone glider still shows zoomed all the way out
+static inline uint8_t density(const uint64_t count, const uint64_t full) {
+    return (uint8_t) (count ? 1 + count * 254 / full : 0);
+}
+
+// Live cells in each byte of w, a byte each
+static inline uint64_t byte_counts(const uint64_t w) {
+    uint64_t v = w - ((w >> 1) & UINT64_C(0x5555555555555555));
+    v = (v & UINT64_C(0x3333333333333333)) + ((v >> 2) & UINT64_C(0x3333333333333333));
+    return (v + (v >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+}
+
+void mips_update(mips_t *m, const grid_t *g) {
+    const int cols = m->width[TILE_LEVEL], rows = m->height[TILE_LEVEL];
+    const int w = m->width[MIPS_BASE], per_tile = 1 << (TILE_LEVEL - MIPS_BASE);
+    for (int ty = 0; ty < rows; ty++) {
+        // Everything from the first tile that changed in the row to the
+        // last, going along the rows of cells is far quicker than down each
+        // tile and recounting the rest changes nothing. A block row of 8x8
+        // blocks is a byte of each of 8 words, so the counts of a whole
+        // word's worth add up side by side
+        const uint8_t *dirty = m->dirty[TILE_LEVEL] + (size_t) ty * cols;
+        int tx0 = 0, tx1 = cols;
+        while (tx0 < tx1 && !dirty[tx0]) tx0++;
+        while (tx1 > tx0 && !dirty[tx1 - 1]) tx1--;
+        if (tx0 == tx1) continue;
+
+        const int by1 = SDL_min((ty + 1) * per_tile, m->height[MIPS_BASE]);
+        for (int by = ty * per_tile; by < by1; by++) {
+            memset(m->sums + tx0, 0, (size_t) (tx1 - tx0) * sizeof(uint64_t));
+            for (int y = by << MIPS_BASE; y < SDL_min((by + 1) << MIPS_BASE, g->height); y++) {
+                const uint64_t *row = grid_row(g, y);
+                for (int tx = tx0; tx < tx1; tx++) m->sums[tx] += byte_counts(row[tx]);
+            }
+            uint32_t *out = m->level[MIPS_BASE] + (size_t) by * w;
+            for (int x = tx0 * per_tile; x < SDL_min(tx1 * per_tile, w); x++) {
+                out[x] = (uint32_t) (m->sums[x / per_tile] >> 8 * (x % per_tile) & 0xFF);
+            }
+        }
+        for (int k = MIPS_BASE + 1; k <= TILE_LEVEL; k++) {
+            const int span = 1 << (TILE_LEVEL - k);
+            reduce(m, k, ty * span, SDL_min((ty + 1) * span, m->height[k]), tx0 * span, SDL_min(tx1 * span, m->width[k]));
+        }
+    }
+    // Every level passes what it recounted on to the one above
+    for (int k = TILE_LEVEL; k <= m->top; k++) {
+        const int w = m->width[k], h = m->height[k];
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                uint8_t *dirty = &m->dirty[k][(size_t) y * w + x];
+                if (!*dirty) continue;
+                *dirty = 0;
+                if (k > TILE_LEVEL) reduce(m, k, y, y + 1, x, x + 1);
+                if (k < m->top) m->dirty[k + 1][(size_t) (y / 2) * m->width[k + 1] + x / 2] = 1;
+            }
+        }
+    }
+}
+
+bool view_create(view_t *v, const int width, const int height) {
+    memset(v, 0, sizeof(*v));
+    // Samples are at least a pixel, plus one cut off at each edge
+    v->capacity = (width + 2) * (height + 2);
+    v->samples = SDL_calloc((size_t) v->capacity, 1);
+    return v->samples != NULL;
+}
+
+void view_destroy(view_t *v) {
+    SDL_free(v->samples);
+    v->samples = NULL;
+}
+
+int view_level(const camera_t *c) {
+    int level = 0;
+    while (level < 30 && c->zoom * (1 << level) < 1) level++;
+    return level;
+}
+
+// First and one past the last sample of the board's `cells` at `level`
+// that show up in `pixels` starting at cell `from`
+static void span(const double from, const double zoom, const int pixels, const int cells, const int level, int *first, int *last) {
+    const double size = (double) (1 << level);
+    const int samples = (int) ((cells + size - 1) / size);
+    *first = (int) SDL_clamp(SDL_floor(from / size), 0, samples);
+    *last = (int) SDL_clamp(SDL_ceil((from + pixels / zoom) / size), *first, SDL_min(samples, *first + pixels + 2));
+}
+
+void view_capture(view_t *v, const grid_t *g, mips_t *m, const camera_t *c, const int width, const int height) {
+    v->camera = *c;
+    v->level = SDL_min(view_level(c), m->top);
+    int x1, y1;
+    span(c->x, c->zoom, width, g->width, v->level, &v->x, &x1);
+    span(c->y, c->zoom, height, g->height, v->level, &v->y, &y1);
+    v->width = x1 - v->x;
+    v->height = y1 - v->y;
+    uint8_t *out = v->samples;
+
+    if (v->level == 0) {
+        for (int y = v->y; y < y1; y++) {
+            const uint64_t *row = grid_row(g, y);
+            for (int x = v->x; x < x1; x++) {
+                *out++ = (uint8_t) (g->planes > 1 ? grid_state(g, y, x) : (int) (row[x / 64] >> (x % 64) & 1));
+            }
+        }
+    } else if (v->level < MIPS_BASE) {
+        // Blocks this small never straddle a word. Adding up the bits of
+        // each block in place leaves their counts in 2^level bit fields,
+        // spread out over two words so the rows can be summed up too
+        static const uint64_t halves[] = {UINT64_C(0x5555555555555555), UINT64_C(0x3333333333333333), UINT64_C(0x0F0F0F0F0F0F0F0F)};
+        const int size = 1 << v->level, per_word = 64 / size, full = size * size;
+        const uint64_t field = (UINT64_C(1) << 2 * size) - 1;
+        for (int sy = v->y; sy < y1; sy++, out += v->width) {
+            for (int word = v->x / per_word; word <= (x1 - 1) / per_word; word++) {
+                uint64_t even = 0, odd = 0;
+                for (int y = sy * size; y < SDL_min(sy * size + size, g->height); y++) {
+                    uint64_t w = grid_row(g, y)[word];
+                    for (int k = 0; k < v->level; k++) w = (w & halves[k]) + (w >> (1 << k) & halves[k]);
+                    even += w & halves[v->level];
+                    odd += w >> size & halves[v->level];
+                }
+                const int first = SDL_max(word * per_word, v->x), last = SDL_min(word * per_word + per_word, x1);
+                for (int sx = first; sx < last; sx++) {
+                    const int i = sx - word * per_word;
+                    const int count = (int) ((i & 1 ? odd : even) >> (2 * size * (i / 2)) & field);
+                    out[sx - v->x] = density((uint64_t) count, (uint64_t) full);
+                }
+            }
+        }
+    } else {
+        mips_update(m, g);
+        const uint32_t *level = m->level[v->level];
+        const uint64_t full = UINT64_C(1) << 2 * SDL_min(v->level, MIPS_EXACT);
+        for (int y = v->y; y < y1; y++) {
+            const uint32_t *row = level + (size_t) y * m->width[v->level];
+            for (int x = v->x; x < x1; x++) *out++ = density(row[x], full);
+        }
+    }
+}
+
+void view_capture_field(view_t *v, const float *cells, const int cells_width, const int cells_height, const camera_t *c, const int width, const int height) {
+    int top = 0;
+    while (1 << top < SDL_max(cells_width, cells_height)) top++;
+    v->camera = *c;
+    v->level = SDL_min(view_level(c), top);
+    int x1, y1;
+    span(c->x, c->zoom, width, cells_width, v->level, &v->x, &x1);
+    span(c->y, c->zoom, height, cells_height, v->level, &v->y, &y1);
+    v->width = x1 - v->x;
+    v->height = y1 - v->y;
+    uint8_t *out = v->samples;
+
+    const int size = 1 << v->level;
+    const float scale = 255.0f / (float) size / (float) size;
+    for (int sy = v->y; sy < y1; sy++) {
+        const int y_end = SDL_min(sy * size + size, cells_height);
+        for (int sx = v->x; sx < x1; sx++) {
+            const int x_end = SDL_min(sx * size + size, cells_width);
+            float sum = 0;
+            for (int y = sy * size; y < y_end; y++) {
+                const float *row = cells + (size_t) y * cells_width;
+                for (int x = sx * size; x < x_end; x++) sum += row[x];
+            }
+            *out++ = (uint8_t) (sum * scale + 0.5f);
+        }
+    }
+}
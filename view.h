@@ -0,0 +1,83 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "life.h"
+
+// What part of a board a window shows, at any zoom.
+//
+// Zoomed in every cell gets a sample. Zoomed out a sample stands for a
+// 2^level x 2^level block of cells, just enough of them that each one
+// still covers a screen pixel, and holds how full the block is. That keeps
+// a capture about as big as the window no matter how much of the board it
+// spans.
+//
+// Blocks of 8x8 cells and up are counted ahead of time in a mip pyramid
+// (mips_t), every level summing 2x2 entries of the one below. Only the
+// tiles that changed since the pyramid was last brought up to date are
+// recounted, and only the entries above them.
+
+#define MIPS_BASE 3     // the first level kept, below it cells are counted directly
+// Levels up to here hold exact counts. A block above it has more cells than
+// an entry holds, so they hold the count divided by 4 for every level past
+// it, rounded up so a block with anything in it never counts as empty
+#define MIPS_EXACT 15
+#define MIPS_MAX 32
+
+typedef struct Mips {
+    int top;                    // the level with a single entry
+    int width[MIPS_MAX], height[MIPS_MAX];
+    uint32_t *level[MIPS_MAX];  // from MIPS_BASE up
+    // Per entry from the tile level (6) up, needs recounting. The tile
+    // level is filled in by mips_mark()
+    uint8_t *dirty[MIPS_MAX];
+    uint64_t *sums;             // a block row's worth, for counting
+} mips_t;
+
+// Window position: the board cell at its top left corner and screen pixels
+// per cell.
+typedef struct Camera {
+    double x, y;
+    double zoom;
+} camera_t;
+
+typedef struct View {
+    camera_t camera;    // what it was captured for
+    int level;          // a sample is 2^level x 2^level cells
+    int x, y;           // the first sample, counted in samples
+    int width, height;  // samples, only the ones on the board
+    int capacity;       // samples there's room for either way
+    // Row by row: the state of each cell at level 0, above it how full
+    // each block is, 1 to 255 if there's anything in it at all and 0 if
+    // not. Fields sample their values instead
+    uint8_t *samples;
+} view_t;
+
+// A pyramid for g with every tile marked, false if out of memory.
+bool mips_create(mips_t *m, const grid_t *g);
+void mips_destroy(mips_t *m);
+// Remembers the tiles flagged in `changed` (laid out like tiles_t) as
+// needing a recount.
+void mips_mark(mips_t *m, const uint8_t *changed);
+// Recounts everything marked since the last update.
+void mips_update(mips_t *m, const grid_t *g);
+
+// Room for a window of width x height pixels at any camera, false if out
+// of memory.
+bool view_create(view_t *v, int width, int height);
+void view_destroy(view_t *v);
+
+// The level a camera samples a board at.
+int view_level(const camera_t *c);
+
+// Samples what a width x height pixel window shows of g through camera c.
+// Zoomed out past MIPS_BASE the pyramid is brought up to date first.
+void view_capture(view_t *v, const grid_t *g, mips_t *m, const camera_t *c, int width, int height);
+// The same for a cells_width x cells_height board of values from 0 to 1,
+// row by row, like a Lenia board's. Samples are the value, or the block's
+// average, scaled to 255. There's no pyramid: zoomed out every cell in
+// view is added up.
+void view_capture_field(view_t *v, const float *cells, int cells_width, int cells_height, const camera_t *c, int width, int height);
+
+#endif